@@ -10,13 +10,25 @@
 
 #include <math.h>
 #include <string.h>
+#include <stddef.h>
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
+#include <list>
+#include <chrono>
+#include <functional>
+#include <tuple>
 
 #include <limits.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
 #include "random.hh"
+#include "half.hh"
+#include "thread.hh"
 
 // used node types (must be consecutive numbers)
 #define NODE_INPUT    1
@@ -30,6 +42,12 @@
 // computation precision type
 #define DTYPE float
 
+// history storage type (DTYPE, half or bfloat), values are
+// converted to DTYPE for computation and gradients stay in DTYPE
+#ifndef HTYPE
+#define HTYPE DTYPE
+#endif
+
 // parameter compression level
 #define DTYPE_PRECISION 1e-3
 
@@ -45,16 +63,203 @@
 // mutation probability per byte
 #define MUTATION_PROB 1e-3
 
+// number of fan-in histogram buckets (powers of 2)
+#define FANIN_BUCKETS 8
+
+// dense crossover operators
+#define CROSSOVER_POINT   0
+#define CROSSOVER_KPOINT  1
+#define CROSSOVER_UNIFORM 2
+
+// number of points in k-point crossover
+#define CROSSOVER_POINTS 4
+
+// dna capacity use that triggers search space growth
+#define GROWTH_USAGE 0.5
+
+// relative growth of max hidden nodes and links per step
+#define GROWTH_STEP 1.0
+
+// population memory budget in bytes (0 is unlimited)
+#define MEMORY_BUDGET 0
+
+// graph evaluation budget in seconds (0 is unlimited)
+#define LATENCY_BUDGET 0
+
+// graph evaluation cost measures
+#define COST_LINKS 0
+#define COST_NODES 1
+#define COST_TIME  2
+
+// max graphs kept on pareto front of fitness and cost
+#define PARETO_SIZE 16
+
+// training samples between racing checks
+#define RACE_CHUNK 100
+
+// fraction of graphs promoted to the next evaluation rung by default
+#define PROMOTION_RATIO 0.5
+
+// graphs evaluated together on common samples by one task
+#define COMMON_GROUP 8
+
+// graphs competing in a tournament selection
+#define TOURNAMENT_SIZE 2
+
+// max bytes of a dense genome, larger geometries are rejected on load
+#define GENOME_LIMIT (1u << 28)
+
+// number of graph hashes kept in fitness cache
+#define MEMO_CACHE_SIZE 1024
+
+// fraction of batch trained by graphs with memoized fitness
+#define MEMO_BATCH 0.1
+
+// number of training samples per episode
+#define BATCH_SIZE 1000
+
+// data splits
+#define SPLIT_TRAIN 0
+#define SPLIT_TEST  1
+
+// number of samples per validation task
+#define VALIDATION_CHUNK 250
+
+// sparse genome header marker
+#define SPARSE_MAGIC 0x50534745
+
+// optimizer types
+#define OPTIMIZER_SGD      0
+#define OPTIMIZER_MOMENTUM 1
+#define OPTIMIZER_ADAM     2
+
+// reward baseline types
+#define BASELINE_NONE  0
+#define BASELINE_NODE  1
+#define BASELINE_GRAPH 2
+
+// running mean reward baseline decay
+#define BASELINE_DECAY 0.99
+
+// momentum and adam moment decays
+#define MOMENTUM_BETA1 0.9
+#define MOMENTUM_BETA2 0.999
+
+// adam denominator term
+#define ADAM_EPSILON 1e-8
+
+// parameter update rule applied to arrays of parameters and gradients
+class Optimizer
+{
+public:
+  Optimizer(DTYPE lr, int baseline) : _lr(lr), _baseline(baseline) {}
+  virtual ~Optimizer() {}
+
+  // optimizer type
+  virtual int type() const = 0;
+
+  // number of per-parameter moment arrays
+  virtual int moments() const = 0;
+
+  // update parameters p from gradients g, m and v are moment arrays
+  virtual void apply(DTYPE* p, const DTYPE* g, DTYPE* m, DTYPE* v,
+                     int size, uint32_t step) const = 0;
+
+  // reward baseline type
+  int baseline() const { return _baseline; }
+
+protected:
+  DTYPE _lr;
+  int _baseline;
+};
+
+// plain stochastic gradient descent
+class SGD: public Optimizer
+{
+public:
+  SGD(DTYPE lr = LEARNING_RATE, int baseline = BASELINE_NONE) :
+  Optimizer(lr, baseline) {}
+  virtual int type() const { return OPTIMIZER_SGD; }
+  virtual int moments() const { return 0; }
+  virtual void apply(DTYPE* p, const DTYPE* g, DTYPE* m, DTYPE* v,
+                     int size, uint32_t step) const
+  {
+    //p = p - rate * dL/dp
+    for (int i=0; i<size; i++) p[i] -= _lr * g[i];
+  }
+};
+
+// gradient descent with momentum
+class Momentum: public Optimizer
+{
+public:
+  Momentum(DTYPE lr = LEARNING_RATE, int baseline = BASELINE_NONE) :
+  Optimizer(lr, baseline) {}
+  virtual int type() const { return OPTIMIZER_MOMENTUM; }
+  virtual int moments() const { return 1; }
+  virtual void apply(DTYPE* p, const DTYPE* g, DTYPE* m, DTYPE* v,
+                     int size, uint32_t step) const
+  {
+    //m = beta * m + dL/dp, p = p - rate * m
+    for (int i=0; i<size; i++)
+    {
+      m[i] = MOMENTUM_BETA1 * m[i] + g[i];
+      p[i] -= _lr * m[i];
+    }
+  }
+};
+
+// adaptive moment estimation
+class Adam: public Optimizer
+{
+public:
+  Adam(DTYPE lr = LEARNING_RATE, int baseline = BASELINE_NONE) :
+  Optimizer(lr, baseline) {}
+  virtual int type() const { return OPTIMIZER_ADAM; }
+  virtual int moments() const { return 2; }
+  virtual void apply(DTYPE* p, const DTYPE* g, DTYPE* m, DTYPE* v,
+                     int size, uint32_t step) const
+  {
+    // bias corrected rate for step t = step + 1
+    DTYPE c1 = 1 - pow(MOMENTUM_BETA1, step + 1);
+    DTYPE c2 = 1 - pow(MOMENTUM_BETA2, step + 1);
+    DTYPE lr = _lr * sqrtf(c2) / c1;
+    for (int i=0; i<size; i++)
+    {
+      m[i] = MOMENTUM_BETA1 * m[i] + (1 - MOMENTUM_BETA1) * g[i];
+      v[i] = MOMENTUM_BETA2 * v[i] + (1 - MOMENTUM_BETA2) * g[i] * g[i];
+      p[i] -= lr * m[i] / (sqrtf(v[i]) + ADAM_EPSILON);
+    }
+  }
+};
+
+// create optimizer of given type, nullptr if type is unknown
+inline Optimizer* new_optimizer(int type, DTYPE lr = LEARNING_RATE,
+                                int baseline = BASELINE_NONE)
+{
+  switch(type)
+  {
+    case OPTIMIZER_SGD: return new SGD(lr, baseline);
+    case OPTIMIZER_MOMENTUM: return new Momentum(lr, baseline);
+    case OPTIMIZER_ADAM: return new Adam(lr, baseline);
+  }
+  return nullptr;
+}
+
 // node base class
 class Node
 {
 public:
   // ctor
-  Node(RNG& rng) : _rng(rng)
+  Node(RNG& rng) : _rng(&rng)
   {
     _cache = true;
     _bias = 1;
     _bgrad = 0;
+    _bm = 0;
+    _bv = 0;
+    _baseline = 0;
+    _dirty = false;
   }
   
   // dtor
@@ -73,7 +278,7 @@ public:
   virtual DTYPE dSdb(int t = -1) const = 0;
 
   // activation at time t
-  virtual DTYPE A(int t = -1) const { return P(t) > _rng.uniform_dec(0, 1); }
+  virtual DTYPE A(int t = -1) const { return P(t) > _rng->uniform_dec(0, 1); }
     
   // reset state but keep the gradients
   void reset()
@@ -89,6 +294,24 @@ public:
   {
     _cache = false;
   }
+
+  // reset to newly created state, keep allocated memory for reuse
+  void recycle()
+  {
+    reset();
+    _input.clear();
+    _weight.clear();
+    _wgrad.clear();
+    _wm.clear();
+    _wv.clear();
+    _cache = true;
+    _bias = 1;
+    _bgrad = 0;
+    _bm = 0;
+    _bv = 0;
+    _baseline = 0;
+    _dirty = false;
+  }
   
   // set bias
   void set_bias(DTYPE bias)
@@ -135,19 +358,37 @@ public:
     if (_state.size() > _reward.size()) _reward.push_back(reward);
   }
 
-  // accumulate gradients
-  void gradient(DTYPE gamma = GAMMA_DISCOUNT)
+  // accumulate gradients, baseline is the graph mean reward if used
+  void gradient(DTYPE gamma = GAMMA_DISCOUNT,
+                int mode = BASELINE_NONE, DTYPE baseline = 0)
   {
     auto rsize = _reward.size();
     auto isize = _input.size();
+
+    // mean reward per step, node baseline is updated after use
+    DTYPE b = 0;
+    if (mode == BASELINE_NODE) b = _baseline;
+    if (mode == BASELINE_GRAPH) b = baseline;
   
-    // get discounted rewards
+    // get discounted rewards less expected discounted rewards
     DTYPE r = 0;
+    DTYPE e = 0;
     std::vector<DTYPE> reward(_reward.size());
     for (int i=rsize-1; i>=0; i--)
     {
       r = gamma * r  + _reward[i];
-      reward[i] = r;
+      e = gamma * e + b;
+      reward[i] = r - e;
+    }
+
+    // update node baseline
+    if (mode == BASELINE_NODE)
+    {
+      for (int i=0; i<rsize; i++)
+      {
+        _baseline = BASELINE_DECAY * _baseline
+                  + (1 - BASELINE_DECAY) * _reward[i];
+      }
     }
 
     // cache the state derivatives
@@ -155,34 +396,71 @@ public:
     for (int t=0; t<rsize; t++) dlds[t] = dLdS(reward[t], t);
 
     // update gradient
-    for (int t=0; t<rsize; t++)
+    for (int i=0; i<isize; i++)
     {
       //dL/dw
-      for (int i=0; i<isize; i++) _wgrad[i] += dlds[t] * dSdw(i, t);
-      //dL/db
-      _bgrad += dlds[t] * dSdb(t);
+      DTYPE dldw = 0;
+      for (int t=0; t<rsize; t++) dldw += dlds[t] * dSdw(i, t);
+      _wgrad[i] += dldw;
     }
+    //dL/db
+    for (int t=0; t<rsize; t++) _bgrad += dlds[t] * dSdb(t);
   }
   
-  // apply gradients
-  void update(DTYPE lr = LEARNING_RATE)
+  // apply gradients with optimizer at its update step,
+  // returns false if parameters did not change
+  bool update(const Optimizer& opt, uint32_t step = 0)
   {
     auto size = _input.size();
 
-    //w = w - rate * dL/dw
-    for (int i=0; i<size; i++) _weight[i] -= lr * _wgrad[i];
-    //b = b - rate * dL/db
-    _bias -= lr * _bgrad;
+    // input nodes have no parameters
+    if (type() == NODE_INPUT) return false;
+
+    // zero gradients change parameters only through moments
+    bool active = (_bgrad != 0 || opt.moments() > 0);
+    for (int i=0; i<size && !active; i++) active = (_wgrad[i] != 0);
+    if (!active) return false;
+
+    // optimizer state is kept alongside weights
+    auto moments = opt.moments();
+    if (moments > 0 && _wm.size() != size) { _wm.assign(size, 0); _bm = 0; }
+    if (moments > 1 && _wv.size() != size) { _wv.assign(size, 0); _bv = 0; }
+    auto wm = (moments > 0) ? _wm.data() : nullptr;
+    auto wv = (moments > 1) ? _wv.data() : nullptr;
+
+    // weights in chunks
+    DTYPE old[64];
+    bool changed = false;
+    for (int i=0; i<size; i+=64)
+    {
+      int n = std::min(64, (int)size - i);
+      memcpy(old, &_weight[i], n * sizeof(DTYPE));
+      opt.apply(&_weight[i], &_wgrad[i], wm ? wm + i : nullptr,
+                wv ? wv + i : nullptr, n, step);
+      changed = changed || memcmp(old, &_weight[i], n * sizeof(DTYPE));
+    }
+
+    // bias
+    auto bias = _bias;
+    opt.apply(&_bias, &_bgrad, &_bm, &_bv, 1, step);
+    changed = changed || (bias != _bias);
 
     // reset gradients
     _wgrad.assign(_wgrad.size(), 0);
     _bgrad = 0;
+    return changed;
+  }
+
+  // apply gradients with plain SGD at given learning rate
+  bool update(DTYPE lr)
+  {
+    return update(SGD(lr));
   }
 
   // policy P to derive dLdS
   DTYPE P(int t = -1) const
   {
-    auto state = (t == -1) ? _state.back() : _state[t];
+    DTYPE state = (t == -1) ? _state.back() : _state[t];
     return sigmoid(state);
   }
   
@@ -194,7 +472,7 @@ public:
     // action 0 loss: -log(1-P) * r
     // action 1 loss: -log(P) * r
     auto p = P(t);
-    auto a = (t == -1) ? _output.back() : _output[t];
+    DTYPE a = (t == -1) ? _output.back() : _output[t];
     return -logf((1 - a) * (1 - p) + a * p) * reward;
   }
 
@@ -202,8 +480,8 @@ public:
   DTYPE dLdS(DTYPE reward, int t = -1) const
   {
     if (type() == NODE_INPUT) return 0;
-    auto state = (t == -1) ? _state.back() : _state[t];
-    auto active = (t == -1) ? _output.back() : _output[t];
+    DTYPE state = (t == -1) ? _state.back() : _state[t];
+    DTYPE active = (t == -1) ? _output.back() : _output[t];
     auto exp_s = expf(state);
     auto sign = (1 - 2 * active);
     return sign * reward * sigmoid(sign * state);
@@ -267,35 +545,52 @@ public:
   std::vector<Node*> _input;  // input connections
   std::vector<DTYPE> _weight; // input weights
   std::vector<DTYPE> _wgrad; // weights gradients
-  std::vector<DTYPE> _state;  // state history
-  std::vector<DTYPE> _output;  // output history
-  std::vector<DTYPE> _reward; // reward history
+  std::vector<HTYPE> _state;  // state history
+  std::vector<HTYPE> _output;  // output history
+  std::vector<HTYPE> _reward; // reward history
+  std::vector<DTYPE> _wm; // weights first moment
+  std::vector<DTYPE> _wv; // weights second moment
   DTYPE _bias;
   DTYPE _bgrad;
+  DTYPE _bm; // bias first moment
+  DTYPE _bv; // bias second moment
+  DTYPE _baseline; // running mean reward
   bool _cache;
-  RNG& _rng;
+  bool _dirty; // parameters changed since graph save
+  RNG* _rng;
 };
 
 // special type of node to keep track input data
 class Input: public Node
 {
 public:
-  Input(RNG& rng) : Node(rng) {}
+  Input(RNG& rng) : Node(rng)
+  {
+    _data = 0;
+    _value = &_data;
+  }
+  // read value from external storage (e.g. graph input buffer)
+  void bind(DTYPE* value)
+  {
+    _cache = false;
+    _value = value;
+  }
   void set(DTYPE value)
   { 
     _cache = false;
-    _value = value;
+    *_value = value;
   }
   virtual int type() const { return NODE_INPUT; }
   virtual DTYPE S(int t = -1) const
   { 
-    return (t == -1) ? _value : _state[t];
+    return (t == -1) ? *_value : (DTYPE)_state[t];
   }
   virtual DTYPE dSdw(int i, int t = -1) const { return 0; }
   virtual DTYPE dSdb(int t = -1) const { return 0; }
   virtual DTYPE A(int t = -1) const { return S(); }
 private:
-  DTYPE _value;
+  DTYPE* _value;
+  DTYPE _data;
 };
 
 // addition opertation
@@ -370,12 +665,30 @@ public:
   }
 };
 
+// mutation probability per byte of each genome field
+struct Mutation
+{
+  Mutation(DTYPE prob = MUTATION_PROB)
+  : type(prob), bias(prob), source(prob), weight(prob) {}
+
+  DTYPE type;   // node type
+  DTYPE bias;   // node bias
+  DTYPE source; // link source
+  DTYPE weight; // link weight
+};
+
 // computational graph
 class Graph
 {
 public:
-  Graph(int input, int output, int mx_hidden, int mx_links, RNG& rng) : _rng(rng)
+  Graph(int input, int output, int mx_hidden, int mx_links, RNG& rng) : _rng(&rng)
   {
+    _optimizer = &default_optimizer();
+    _step = 0;
+    _baseline = 0;
+    _pending = 0;
+    _synced = false;
+
     _meta.input = input;
     _meta.output = output;
     _meta.hidden = mx_hidden;
@@ -383,21 +696,24 @@ public:
 
     for (auto i=0; i<_meta.input; i++)
     {
-      _nodes.push_back(new Input(_rng));
+      _nodes.push_back(new Input(*_rng));
       _nodes_index.push_back(i);
-      _links_index.emplace_back();
+      _links_offset.push_back(0);
     }
     for (auto i=0; i<_meta.output; i++)
     {
       _nodes.push_back(new_node());
       _nodes_index.push_back(_meta.input + i);
-      _links_index.emplace_back();
+      _links_offset.push_back(0);
     }    
+    bind(_meta.input);
   }
 
   ~Graph()
   {
     clear();
+    for (auto& e: _free)
+    for (auto node_p: e) delete node_p;
   }
 
   // number of graph connections
@@ -414,12 +730,19 @@ public:
     return (_meta.hidden + _meta.output) * _meta.links;
   }
   
+  // remove all nodes (kept for reuse) and reset training state
   void clear()
   {
-    for (auto e: _nodes) delete e;
+    for (auto e: _nodes) _free[e->type()].push_back(e);
     _nodes.clear();
     _nodes_index.clear();
     _links_index.clear();
+    _links_offset.clear();
+    _dirty.clear();
+    _synced = false;
+    _step = 0;
+    _baseline = 0;
+    _pending = 0;
   }
 
   void set(uint32_t input, DTYPE value)
@@ -427,11 +750,39 @@ public:
     ((Input*)_nodes[input])->set(value);
   }
 
+  // set first size inputs to data * scale + offset in one pass
+  void set_inputs(const uint8_t* data, uint32_t size,
+                  DTYPE scale = 1, DTYPE offset = 0)
+  {
+    size = std::min(size, (uint32_t)_inputs.size());
+    auto inputs = _inputs.data();
+    for (auto i=0; i<size; i++) inputs[i] = data[i] * scale + offset;
+    for (auto i=0; i<size; i++) _nodes[i]->_cache = false;
+  }
+
+  // set first size inputs to data * scale + offset in one pass
+  void set_inputs(const float* data, uint32_t size,
+                  DTYPE scale = 1, DTYPE offset = 0)
+  {
+    size = std::min(size, (uint32_t)_inputs.size());
+    auto inputs = _inputs.data();
+    for (auto i=0; i<size; i++) inputs[i] = data[i] * scale + offset;
+    for (auto i=0; i<size; i++) _nodes[i]->_cache = false;
+  }
+
   DTYPE get(uint32_t output)
   {
     return _nodes[_meta.input + output]->output();
   }
 
+  // get first size outputs at once
+  void outputs(DTYPE* output, uint32_t size)
+  {
+    size = std::min(size, _meta.output);
+    auto nodes = &_nodes[_meta.input];
+    for (auto i=0; i<size; i++) output[i] = nodes[i]->output();
+  }
+
   void reset()
   {
     for (auto e: _nodes) e->reset();
@@ -445,20 +796,170 @@ public:
   void reward(DTYPE reward)
   {
     for (auto e: _nodes) e->reward(reward);
+    _pending = BASELINE_DECAY * _pending + (1 - BASELINE_DECAY) * reward;
   }
 
   void gradient(DTYPE gamma = GAMMA_DISCOUNT)
   {
-    for (auto e: _nodes) e->gradient(gamma);
+    auto mode = _optimizer->baseline();
+    for (auto e: _nodes) e->gradient(gamma, mode, _baseline);
+
+    // update graph baseline with rewards since last gradient
+    _baseline = _pending;
+  }
+
+  // apply gradients with graph optimizer
+  void update()
+  {
+    update(*_optimizer);
+  }
+
+  // apply gradients with plain SGD at given learning rate
+  void update(DTYPE lr)
+  {
+    update(SGD(lr));
+  }
+
+  // apply gradients with given optimizer
+  void update(const Optimizer& opt)
+  {
+    // inputs have no parameters and no genes
+    auto nodes_size = _nodes.size();
+    for (auto i=_meta.input; i<nodes_size; i++)
+    {
+      auto node_p = _nodes[i];
+      if (node_p->update(opt, _step) && !node_p->_dirty)
+      {
+        node_p->_dirty = true;
+        _dirty.push_back(i);
+      }
+    }
+    _step++;
+  }
+
+  // set update rule (not owned by graph)
+  void set_optimizer(const Optimizer& opt)
+  {
+    _optimizer = &opt;
+  }
+
+  // plain SGD shared by graphs without optimizer
+  static const Optimizer& default_optimizer()
+  {
+    static const SGD sgd;
+    return sgd;
+  }
+
+  // copy of structure, weights and optimizer state with own activation
+  // state and RNG, used to train the graph on many threads
+  Graph* replica(RNG& rng) const
+  {
+    auto g = new Graph(0,0,0,0,rng);
+    g->_meta = _meta;
+    g->_optimizer = _optimizer;
+    g->_step = _step;
+    g->_baseline = _baseline;
+    g->_pending = _pending;
+    g->_nodes_index = _nodes_index;
+    g->_links_index = _links_index;
+    g->_links_offset = _links_offset;
+
+    // node ptr to rt-index
+    auto nodes_size = _nodes.size();
+    std::unordered_map<const Node*, uint32_t> node_map;
+    for (auto i=0; i<nodes_size; i++)
+    {
+      node_map.emplace(_nodes[i], i);
+      g->_nodes.push_back(g->new_node(_nodes[i]->type()));
+    }
+
+    for (auto i=0; i<nodes_size; i++)
+    {
+      auto source_p = _nodes[i];
+      auto target_p = g->_nodes[i];
+      auto links_size = source_p->_input.size();
+      for (auto j=0; j<links_size; j++)
+      {
+        auto source = node_map[source_p->_input[j]];
+        target_p->insert(g->_nodes[source], source_p->_weight[j]);
+      }
+      target_p->set_bias(source_p->get_bias());
+      target_p->_baseline = source_p->_baseline;
+    }
+
+    g->bind(_inputs.size());
+    return g;
   }
 
-  void update(DTYPE lr = LEARNING_RATE)
+  // add gradients of replicas and average their baselines
+  void reduce(Graph* const* replicas, uint32_t size)
   {
-    for (auto e: _nodes) e->update(lr);
+    if (size == 0) return;
+    auto nodes_size = _nodes.size();
+    for (auto i=0; i<nodes_size; i++)
+    {
+      auto node_p = _nodes[i];
+      auto links_size = node_p->_wgrad.size();
+      DTYPE baseline = 0;
+      for (auto k=0; k<size; k++)
+      {
+        auto other_p = replicas[k]->_nodes[i];
+        for (auto j=0; j<links_size; j++) node_p->_wgrad[j] += other_p->_wgrad[j];
+        node_p->_bgrad += other_p->_bgrad;
+        baseline += other_p->_baseline;
+      }
+      node_p->_baseline = baseline / size;
+    }
+
+    DTYPE baseline = 0;
+    DTYPE pending = 0;
+    for (auto k=0; k<size; k++)
+    {
+      baseline += replicas[k]->_baseline;
+      pending += replicas[k]->_pending;
+    }
+    _baseline = baseline / size;
+    _pending = pending / size;
   }
     
   const std::string& save()
   {
+    // patch parameters of updated nodes when dna layout is current
+    if (_synced && memcmp(_dna.data(), &_meta, sizeof(MetaData)) == 0)
+    {
+      char* data = &_dna[0];
+      for (auto i: _dirty)
+      {
+        auto node_p = _nodes[i];
+        node_p->_dirty = false;
+        if (i < _meta.input) continue;
+
+        auto offset = node_offset(_meta, _nodes_index[i]);
+        ((NodeData*)(data + offset))->bias = to_int(node_p->get_bias());
+
+        auto links_index = _links_index.data() + _links_offset[i];
+        auto links_size = node_p->_input.size();
+        for (auto j=0; j<links_size; j++)
+        {
+          offset = link_offset(_meta, _nodes_index[i], links_index[j]);
+          ((LinkData*)(data + offset))->weight = to_int(node_p->_weight[j]);
+        }
+      }
+      _dirty.clear();
+      return _dna;
+    }
+
+    // move genes of a smaller stored geometry (after growth) into the
+    // current layout, so old links are not read as nodes
+    auto& old = *(const MetaData*)_dna.data();
+    if (_dna.size() >= sizeof(MetaData) && memcmp(&old, &_meta, sizeof(MetaData)) &&
+        old.input == _meta.input && old.output == _meta.output &&
+        old.hidden <= _meta.hidden && old.links <= _meta.links)
+    {
+      relayout(_dna, _meta, _layout);
+      _dna.swap(_layout);
+    }
+
     // resize dna buffer
     auto size = link_offset(_meta, _meta.input + _meta.output + _meta.hidden, 0);
     if (_dna.size() != size) _dna.resize(size);
@@ -495,8 +996,8 @@ public:
     for (auto i=_meta.input; i<nodes_size; i++)
     {
       auto node_p = _nodes[i];
-      auto& links_index = _links_index[i];
-      auto links_size = links_index.size();
+      auto links_index = _links_index.data() + _links_offset[i];
+      auto links_size = node_p->_input.size();
       for (auto j=0; j<links_size; j++)
       {
         auto offset = link_offset(_meta, _nodes_index[i], links_index[j]);
@@ -507,12 +1008,26 @@ public:
         link.weight = to_int(node_p->_weight[j]);
       }
     }
+
+    // dna is in sync with all parameters
+    for (auto e: _nodes) e->_dirty = false;
+    _dirty.clear();
+    _synced = true;
     
     return _dna;
   }
 
   bool load(const std::string& in)
   {
+    // sparse genome is expanded to dense genome
+    if (is_sparse(in))
+    {
+      std::string dense;
+      if (to_dense(in, dense)) return load(dense);
+      clear();
+      return false;
+    }
+
     clear();
         
     // get data buffer
@@ -520,41 +1035,59 @@ public:
     const char* data = in.data();
     
     // load graph according to stored meta data
-    MetaData &meta = *(MetaData*)data;
+    MetaData meta = *(MetaData*)data;
 
     // validate data buffer
+    auto size = genome_size(meta);
+    if (size == 0 || in.size() < size) return false;
     auto max_nodes = meta.input + meta.output + meta.hidden;
-    if (in.size() < link_offset(meta, max_nodes, 0)) return false;
-    _dna = in;
+
+    // index table from store to rt node index (max_nodes is inactive),
+    // reject invalid graph before any node is created
+    _index.assign(max_nodes + 1, max_nodes);
+    uint32_t nodes_size = meta.input;
+    for (auto i=0; i<meta.input; i++) _index[i] = i;
+    for (auto i=meta.input; i<max_nodes; i++)
+    {
+      // validate node (accept 0:NODE_MAXIMUM, 0 is inactive)
+      auto& node = *(const NodeData*)(data + node_offset(meta, i));
+      auto type = node.type % (NODE_MAXIMUM + 1);
+      if (type == NODE_INPUT) return false;
+      if (type != 0) _index[i] = nodes_size++;
+    }
+    if (nodes_size < std::max(_meta.input, meta.input) +
+                     std::max(_meta.output, meta.output)) return false;
+
+    // dna may be loaded in place (see crossover)
+    if (&in != &_dna) _dna.assign(in, 0, size);
+    else _dna.resize(size);
+    char* dna = &_dna[0];
     
     // inputs (not saved)
-    std::unordered_map<uint32_t, uint32_t> node_map; // store to rt node index
     for (auto i=0; i<meta.input; i++)
     {
-      // add input
-      node_map.emplace(i, _nodes.size());
       _nodes_index.push_back(i);
-      _links_index.emplace_back();
-      _nodes.push_back(new Input(_rng));
+      _links_offset.push_back(0);
+      _nodes.push_back(alloc_node(NODE_INPUT));
     }
+    bind(meta.input);
             
     // nodes (hidden + output)
     for (auto i=meta.input; i<max_nodes; i++)
     {
+      if (_index[i] == max_nodes) continue;
+
       // read node
       auto offset = node_offset(meta, i);
-      NodeData &node = *(NodeData*)(data + offset);
-      
-      // validate node (accept 0:NODE_MAXIMUM, 0 is inactive)
-      auto node_ptr = new_node(node.type % (NODE_MAXIMUM + 1));
-      //auto node_ptr = new_node(node.type);
-      if (node_ptr == nullptr) continue;
-      node_ptr->set_bias(to_dec(node.bias));
- 
+      NodeData &node = *(NodeData*)(dna + offset);
+      node.type %= (NODE_MAXIMUM + 1);
+
       // add node
-      node_map.emplace(i, _nodes.size());
+      auto node_ptr = alloc_node(node.type);
+      node_ptr->set_bias(to_dec(node.bias));
+      node.bias = to_int(node_ptr->get_bias());
       _nodes_index.push_back(i);
-      _links_index.emplace_back();
+      _links_offset.push_back(0);
       _nodes.push_back(node_ptr);
     }
     
@@ -562,25 +1095,31 @@ public:
     for (auto i=meta.input; i<max_nodes; i++)
     {
       // validate target node
-      auto target_it = node_map.find(i);
-      if (target_it == node_map.end()) continue;
-
+      auto target = _index[i];
+      if (target == max_nodes) continue;
+      auto target_p = _nodes[target];
+      _links_offset[target] = _links_index.size();
+
+      // validate source nodes (accept 0:max_nodes, max_nodes is inactive)
+      auto links = (LinkData*)(dna + link_offset(meta, i, 0));
+      uint32_t links_size = 0;
       for (auto j=0; j<meta.links; j++)
       {
-        // read link
-        auto offset = link_offset(meta, i, j);
-        LinkData &link = *(LinkData*)(data + offset);
+        links[j].source %= (max_nodes + 1);
+        links_size += (_index[links[j].source] != max_nodes);
+      }
+      target_p->_input.reserve(links_size);
+      target_p->_weight.reserve(links_size);
+      target_p->_wgrad.reserve(links_size);
 
-        // validate source node (accept 0:max_nodes, max_nodes is inactive)
-        auto source_it = node_map.find(link.source % (max_nodes + 1));
-        //auto source_it = node_map.find(link.source);
-        if (source_it == node_map.end()) continue;
-        
-        // create link
-        auto source = (*source_it).second;
-        auto target = (*target_it).second;
-        _nodes[target]->insert(_nodes[source], to_dec(link.weight));
-        _links_index[target].push_back(j);
+      // create links
+      for (auto j=0; j<meta.links; j++)
+      {
+        auto source = _index[links[j].source];
+        if (source == max_nodes) continue;
+        target_p->insert(_nodes[source], to_dec(links[j].weight));
+        links[j].weight = to_int(target_p->_weight.back());
+        _links_index.push_back(j);
       }
     }
 
@@ -589,11 +1128,127 @@ public:
     _meta.output = std::max(_meta.output, meta.output);
     _meta.hidden = std::max(_meta.hidden, meta.hidden);
     _meta.links  = std::max(_meta.links,  meta.links);
+
+    // dna is in sync unless graph size has changed
+    _synced = true;
         
     // validate graph
     return is_valid();
   }
   
+  // max distance from outputs to the nodes reachable from outputs
+  uint32_t depth() const
+  {
+    std::unordered_map<const Node*, uint32_t> distance;
+    std::vector<const Node*> level, next;
+    auto nodes_size = _nodes.size();
+    for (auto i=0; i<_meta.output && _meta.input + i<nodes_size; i++)
+    {
+      auto node_p = _nodes[_meta.input + i];
+      if (distance.emplace(node_p, 0).second) level.push_back(node_p);
+    }
+
+    uint32_t depth = 0;
+    while (level.size())
+    {
+      next.clear();
+      for (auto node_p: level)
+      for (auto input_p: node_p->_input)
+      {
+        if (distance.emplace(input_p, depth + 1).second) next.push_back(input_p);
+      }
+      if (next.size()) depth++;
+      level.swap(next);
+    }
+    return depth;
+  }
+
+  // number of connections of the nodes reachable from outputs
+  uint32_t active_size() const
+  {
+    std::unordered_set<const Node*> visited;
+    std::vector<const Node*> stack;
+    auto nodes_size = _nodes.size();
+    for (auto i=0; i<_meta.output && _meta.input + i<nodes_size; i++)
+    {
+      auto node_p = _nodes[_meta.input + i];
+      if (visited.insert(node_p).second) stack.push_back(node_p);
+    }
+
+    uint32_t size = 0;
+    while (stack.size())
+    {
+      auto node_p = stack.back();
+      stack.pop_back();
+      size += node_p->_input.size();
+      for (auto input_p: node_p->_input)
+      {
+        if (visited.insert(input_p).second) stack.push_back(input_p);
+      }
+    }
+    return size;
+  }
+
+  // canonical hash of the active subgraph (nodes reachable from outputs)
+  uint64_t hash() const
+  {
+    // node ptr to rt-index
+    auto nodes_size = _nodes.size();
+    std::unordered_map<const Node*, uint32_t> node_map;
+    for (auto i=0; i<nodes_size; i++) node_map.emplace(_nodes[i], i);
+
+    // mark nodes reachable from outputs
+    std::vector<bool> active(nodes_size, false);
+    std::vector<uint32_t> stack;
+    for (auto i=0; i<_meta.output && _meta.input + i<nodes_size; i++)
+    {
+      active[_meta.input + i] = true;
+      stack.push_back(_meta.input + i);
+    }
+    while (stack.size())
+    {
+      auto node_p = _nodes[stack.back()];
+      stack.pop_back();
+      for (auto e: node_p->_input)
+      {
+        auto source = node_map[e];
+        if (active[source]) continue;
+        active[source] = true;
+        stack.push_back(source);
+      }
+    }
+
+    // hash nodes in store order with quantized parameters as in dna
+    uint64_t h = hash_word(14695981039346656037ULL, _meta.input);
+    h = hash_word(h, _meta.output);
+    for (auto i=_meta.input; i<nodes_size; i++)
+    {
+      if (!active[i]) continue;
+      auto node_p = _nodes[i];
+      h = hash_word(h, _nodes_index[i]);
+      h = hash_word(h, node_p->type());
+      h = hash_word(h, to_int(node_p->get_bias()));
+      auto links_size = node_p->_input.size();
+      for (auto j=0; j<links_size; j++)
+      {
+        h = hash_word(h, _nodes_index[node_map[node_p->_input[j]]]);
+        h = hash_word(h, to_int(node_p->_weight[j]));
+      }
+    }
+    return h;
+  }
+
+  // FNV-1a step over 32-bit word
+  static uint64_t hash_word(uint64_t h, uint32_t word)
+  {
+    for (auto i=0; i<4; i++)
+    {
+      h ^= (word >> (8 * i)) & 0xFF;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
   bool is_valid()
   {
     auto nodes_size = _nodes.size();
@@ -609,60 +1264,223 @@ public:
     return true;
   }
 
-  Graph* crossover(Graph& other, DTYPE mut_prob = MUTATION_PROB)
+  Graph* crossover(Graph& other, const Mutation& mut = Mutation(),
+                   int type = CROSSOVER_POINT)
   {
-    // update mutable arrays
-    auto& A = save();
-    auto& B = other.save();
-    
-    // validate size
-    if (A.size() != B.size()) return  nullptr;
+    auto g = new Graph(0,0,0,0,*_rng);
+    if (crossover(other, *g, mut, type) == false)
+    {
+      delete g;
+      g = nullptr;
+    }
+    return g;
+  }
+
+  // crossover into existing child graph (not a parent), returns false
+  // if child is invalid
+  bool crossover(Graph& other, Graph& child, const Mutation& mut = Mutation(),
+                 int type = CROSSOVER_POINT)
+  {
+    // update mutable arrays in common geometry
+    MetaData common;
+    if (geometry(other, common) == false) return false;
+    return child.recombine(save(common), other.save(common), *_optimizer, mut, type);
+  }
+
+  // load crossover of parent genomes of the same geometry, random numbers
+  // come from this graph so parents are only read
+  bool recombine(const std::string& A, const std::string& B,
+                 const Optimizer& opt, const Mutation& mut = Mutation(),
+                 int type = CROSSOVER_POINT)
+  {
+    if (A.size() != B.size()) return false;
 
     // randomize order
-    auto order = _rng.uniform_int(1);
-    const std::string* pa = (order) ? &A : &B;
-    const std::string* pb = (order) ? &B : &A;
+    auto order = _rng->uniform_int(1);
+    auto pa = (order) ? A.data() : B.data();
+    auto pb = (order) ? B.data() : A.data();
 
-    // 1-point crossover
-    auto offset = sizeof(MetaData);
-    auto index = _rng.uniform_int(offset, A.size()-1);
-    auto C = pa->substr(0, index) + pb->substr(index);
-    
-    // set mutation level
+    // child dna
+    auto& C = _dna;
+    C.resize(A.size());
     auto dna = &C[0];
+    memcpy(dna, pa, sizeof(MetaData));
     MetaData& meta = *(MetaData*)dna;
+
+    switch (type)
+    {
+      case CROSSOVER_KPOINT: crossover_points(pa, pb, dna, C.size()); break;
+      case CROSSOVER_UNIFORM: crossover_uniform(pa, pb, dna, meta); break;
+      default: crossover_point(pa, pb, dna, C.size()); break;
+    }
     
-    // get A and B bytes
-    uint8_t a = (*pa)[index];
-    uint8_t b = (*pb)[index];
-    auto bits = _rng.uniform_int(8); // 0-8 shared bits
+    // random mutation of node and link records
+    auto nodes = meta.output + meta.hidden;
+    mutate((uint8_t*)dna + node_offset(meta, meta.input), nodes, sizeof(NodeData),
+           (uint8_t*)dna + link_offset(meta, meta.input, 0), nodes * meta.links,
+           sizeof(LinkData), mut);
 
-    // drop lower bits
-    a >>= 8-bits;
-    a <<= 8-bits;
+    return create(C, opt);
+  }
 
-    // drop higher bits
-    b <<= bits;
-    b >>= bits;
+  // reload graph from dna as a new instance with given optimizer
+  bool create(const std::string& dna, const Optimizer& opt)
+  {
+    _meta = MetaData{0, 0, 0, 0};
+    set_optimizer(opt);
+    return load(dna);
+  }
 
-    // crossover higher and lower bits
-    dna[index] = a | b;
-    
-    // random mutation on each byte
-    for (int i=C.size()-1; i>=offset; i--)
-    if (_rng.uniform_dec(1.0) < mut_prob) dna[i] ^= (1 << _rng.uniform_int(7));
+  // sparse genome of active nodes and links, sorted by store position
+  const std::string& save_sparse()
+  {
+    to_sparse(save(), _sparse);
+    return _sparse;
+  }
 
-    // create instance
-    auto g = new Graph(0,0,0,0,_rng);
-    if (g->load(C) == false)
+  // crossover of sparse genomes aligned by node index and link key
+  Graph* crossover_sparse(Graph& other, const Mutation& mut = Mutation())
+  {
+    auto g = new Graph(0,0,0,0,*_rng);
+    if (crossover_sparse(other, *g, mut) == false)
     {
       delete g;
       g = nullptr;
     }
-
     return g;
   }
 
+  // sparse crossover into existing child graph
+  bool crossover_sparse(Graph& other, Graph& child,
+                        const Mutation& mut = Mutation())
+  {
+    // update mutable arrays in common geometry
+    MetaData common;
+    if (geometry(other, common) == false) return false;
+    return child.recombine_sparse(save_sparse(common), other.save_sparse(common),
+                                  *_optimizer, mut);
+  }
+
+  // load sparse crossover of parent genomes of the same geometry
+  bool recombine_sparse(const std::string& A, const std::string& B,
+                        const Optimizer& opt, const Mutation& mut = Mutation())
+  {
+    // validate geometry
+    if (!is_sparse(A) || !is_sparse(B)) return false;
+    auto& meta = ((const SparseData*)A.data())->meta;
+    auto& other = ((const SparseData*)B.data())->meta;
+    if (memcmp(&meta, &other, sizeof(MetaData))) return false;
+    uint32_t max_nodes = meta.input + meta.output + meta.hidden;
+    uint32_t max_links = (meta.output + meta.hidden) * meta.links;
+
+    // randomize order
+    auto order = _rng->uniform_int(1);
+    auto pa = (order) ? &A : &B;
+    auto pb = (order) ? &B : &A;
+    auto& a = *(const SparseData*)pa->data();
+    auto& b = *(const SparseData*)pb->data();
+    auto a_nodes = (const NodeRecord*)(pa->data() + sizeof(SparseData));
+    auto b_nodes = (const NodeRecord*)(pb->data() + sizeof(SparseData));
+    auto a_links = (const LinkRecord*)(a_nodes + a.nodes);
+    auto b_links = (const LinkRecord*)(b_nodes + b.nodes);
+
+    // 1-point crossover over gene positions (nodes then links), genes
+    // before the point come from A and the rest from B
+    uint32_t point = _rng->uniform_int(max_nodes + max_links - 1);
+    std::vector<NodeRecord> nodes;
+    std::vector<LinkRecord> links;
+    for (auto i=0; i<a.nodes; i++)
+      if (a_nodes[i].index < point) nodes.push_back(a_nodes[i]);
+    for (auto i=0; i<b.nodes; i++)
+      if (b_nodes[i].index >= point) nodes.push_back(b_nodes[i]);
+    for (auto i=0; i<a.links; i++)
+      if (max_nodes + a_links[i].key < point) links.push_back(a_links[i]);
+    for (auto i=0; i<b.links; i++)
+      if (max_nodes + b_links[i].key >= point) links.push_back(b_links[i]);
+
+    // random mutation of gene data
+    mutate((uint8_t*)nodes.data() + offsetof(NodeRecord, data), nodes.size(),
+           sizeof(NodeRecord),
+           (uint8_t*)links.data() + offsetof(LinkRecord, data), links.size(),
+           sizeof(LinkRecord), mut);
+
+    // random activation of absent genes, node genes with node type and
+    // link genes with link source mutation probability
+    auto absent_nodes = max_nodes - meta.input - nodes.size();
+    auto absent_links = max_links - links.size();
+    auto inserts = (absent_nodes > 0) ? _rng->poisson_int(absent_nodes * mut.type) : 0;
+    for (auto i=0; i<inserts; i++)
+    {
+      NodeRecord node;
+      node.index = _rng->uniform_int(meta.input, max_nodes - 1);
+      node.data.type = _rng->uniform_int(NODE_MINIMUM+1, NODE_MAXIMUM);
+      node.data.bias = to_int(1);
+      nodes.push_back(node);
+    }
+    inserts = (absent_links > 0) ? _rng->poisson_int(absent_links * mut.source) : 0;
+    for (auto i=0; i<inserts; i++)
+    {
+      LinkRecord link;
+      link.key = _rng->uniform_int(max_links - 1);
+      link.data.source = _rng->uniform_int(max_nodes - 1);
+      link.data.weight = to_int(1);
+      links.push_back(link);
+    }
+
+    // sort genes by position and drop duplicates of inserted genes
+    std::stable_sort(nodes.begin(), nodes.end(),
+    [](const NodeRecord& x, const NodeRecord& y) { return x.index < y.index; });
+    nodes.erase(std::unique(nodes.begin(), nodes.end(),
+    [](const NodeRecord& x, const NodeRecord& y) { return x.index == y.index; }),
+    nodes.end());
+    std::stable_sort(links.begin(), links.end(),
+    [](const LinkRecord& x, const LinkRecord& y) { return x.key < y.key; });
+    links.erase(std::unique(links.begin(), links.end(),
+    [](const LinkRecord& x, const LinkRecord& y) { return x.key == y.key; }),
+    links.end());
+
+    // write child genome
+    std::string C(sizeof(SparseData) + nodes.size() * sizeof(NodeRecord)
+                  + links.size() * sizeof(LinkRecord), 0);
+    auto& c = *(SparseData*)&C[0];
+    c.magic = SPARSE_MAGIC;
+    c.nodes = nodes.size();
+    c.links = links.size();
+    c.meta = meta;
+    auto data = &C[sizeof(SparseData)];
+    if (nodes.size()) memcpy(data, nodes.data(), nodes.size() * sizeof(NodeRecord));
+    data += nodes.size() * sizeof(NodeRecord);
+    if (links.size()) memcpy(data, links.data(), links.size() * sizeof(LinkRecord));
+
+    return create(C, opt);
+  }
+
+  // mutate fields of node and link records given with their strides
+  void mutate(uint8_t* nodes, uint32_t nodes_size, uint32_t nodes_stride,
+              uint8_t* links, uint32_t links_size, uint32_t links_stride,
+              const Mutation& mut)
+  {
+    auto word = sizeof(uint32_t);
+    mutate(nodes + offsetof(NodeData, type), nodes_size, nodes_stride, word, mut.type);
+    mutate(nodes + offsetof(NodeData, bias), nodes_size, nodes_stride, word, mut.bias);
+    mutate(links + offsetof(LinkData, source), links_size, links_stride, word, mut.source);
+    mutate(links + offsetof(LinkData, weight), links_size, links_stride, word, mut.weight);
+  }
+
+  // flip random bit of each field byte with given probability, the gap
+  // to the next mutated byte is geometric so cost is per mutation
+  void mutate(uint8_t* data, uint32_t count, uint32_t stride, uint32_t size,
+              DTYPE mut_prob)
+  {
+    if (mut_prob <= 0) return;
+    uint64_t bytes = (uint64_t)count * size;
+    for (auto i = _rng->geometric_int(mut_prob); i < bytes;
+         i += 1 + _rng->geometric_int(mut_prob))
+    {
+      data[(i / size) * stride + i % size] ^= (1 << _rng->uniform_int(7));
+    }
+  }
+
   struct MetaData
   {
     uint32_t input;  // input size
@@ -683,6 +1501,312 @@ public:
     uint32_t weight; // link weight
   };
 
+  // sparse genome header followed by node and link records
+  struct SparseData
+  {
+    uint32_t magic; // SPARSE_MAGIC
+    uint32_t nodes; // number of node records
+    uint32_t links; // number of link records
+    MetaData meta;  // dense geometry
+  };
+
+  struct NodeRecord
+  {
+    uint32_t index; // node store index
+    NodeData data;
+  };
+
+  struct LinkRecord
+  {
+    uint32_t key; // link store position (node - input) * links + link
+    LinkData data;
+  };
+
+  static bool is_sparse(const std::string& in)
+  {
+    return in.size() >= sizeof(SparseData) &&
+           ((const SparseData*)in.data())->magic == SPARSE_MAGIC;
+  }
+
+  // keep active nodes (type is not 0) and their links from active nodes
+  bool to_sparse(const std::string& dense, std::string& sparse) const
+  {
+    // validate data buffer
+    if (dense.size() < sizeof(MetaData)) return false;
+    const char* data = dense.data();
+    MetaData meta = *(const MetaData*)data;
+    auto size = genome_size(meta);
+    if (size == 0 || dense.size() < size) return false;
+    auto max_nodes = meta.input + meta.output + meta.hidden;
+
+    // active nodes
+    std::vector<bool> active(max_nodes, false);
+    uint32_t nodes = 0;
+    uint32_t links = 0;
+    for (auto i=0; i<meta.input; i++) active[i] = true;
+    for (auto i=meta.input; i<max_nodes; i++)
+    {
+      auto& node = *(const NodeData*)(data + node_offset(meta, i));
+      active[i] = (node.type % (NODE_MAXIMUM + 1) != 0);
+      nodes += active[i];
+    }
+
+    // active links
+    for (auto i=meta.input; i<max_nodes; i++)
+    {
+      if (!active[i]) continue;
+      for (auto j=0; j<meta.links; j++)
+      {
+        auto& link = *(const LinkData*)(data + link_offset(meta, i, j));
+        auto source = link.source % (max_nodes + 1);
+        links += (source < max_nodes && active[source]);
+      }
+    }
+
+    // write records in store order
+    sparse.resize(sizeof(SparseData) + nodes * sizeof(NodeRecord)
+                  + links * sizeof(LinkRecord));
+    auto& header = *(SparseData*)&sparse[0];
+    header.magic = SPARSE_MAGIC;
+    header.nodes = nodes;
+    header.links = links;
+    header.meta = meta;
+    auto node_p = (NodeRecord*)(&sparse[0] + sizeof(SparseData));
+    auto link_p = (LinkRecord*)(node_p + nodes);
+    for (auto i=meta.input; i<max_nodes; i++)
+    {
+      if (!active[i]) continue;
+      node_p->index = i;
+      node_p->data = *(const NodeData*)(data + node_offset(meta, i));
+      node_p++;
+    }
+    for (auto i=meta.input; i<max_nodes; i++)
+    {
+      if (!active[i]) continue;
+      for (auto j=0; j<meta.links; j++)
+      {
+        auto& link = *(const LinkData*)(data + link_offset(meta, i, j));
+        auto source = link.source % (max_nodes + 1);
+        if (source >= max_nodes || !active[source]) continue;
+        link_p->key = (i - meta.input) * meta.links + j;
+        link_p->data = link;
+        link_p++;
+      }
+    }
+    return true;
+  }
+
+  // expand sparse genome, absent nodes have type 0 and absent links
+  // have source max_nodes (inactive)
+  bool to_dense(const std::string& sparse, std::string& dense) const
+  {
+    // validate data buffer
+    if (!is_sparse(sparse)) return false;
+    auto& header = *(const SparseData*)sparse.data();
+    auto& meta = header.meta;
+    auto size = sizeof(SparseData) + (uint64_t)header.nodes * sizeof(NodeRecord)
+              + (uint64_t)header.links * sizeof(LinkRecord);
+    if (sparse.size() < size) return false;
+    if (genome_size(meta) == 0) return false;
+    if (meta.links == 0 && header.links > 0) return false;
+    auto max_nodes = meta.input + meta.output + meta.hidden;
+    auto max_links = (meta.output + meta.hidden) * meta.links;
+
+    // inactive genome
+    dense.assign(link_offset(meta, max_nodes, 0), 0);
+    char* data = &dense[0];
+    *(MetaData*)data = meta;
+    for (auto i=meta.input; i<max_nodes; i++)
+    for (auto j=0; j<meta.links; j++)
+    {
+      ((LinkData*)(data + link_offset(meta, i, j)))->source = max_nodes;
+    }
+
+    // active genes
+    auto node_p = (const NodeRecord*)(sparse.data() + sizeof(SparseData));
+    auto link_p = (const LinkRecord*)(node_p + header.nodes);
+    for (auto i=0; i<header.nodes; i++, node_p++)
+    {
+      if (node_p->index < meta.input || node_p->index >= max_nodes) return false;
+      *(NodeData*)(data + node_offset(meta, node_p->index)) = node_p->data;
+    }
+    for (auto i=0; i<header.links; i++, link_p++)
+    {
+      if (link_p->key >= max_links) return false;
+      auto node = meta.input + link_p->key / meta.links;
+      auto link = link_p->key % meta.links;
+      *(LinkData*)(data + link_offset(meta, node, link)) = link_p->data;
+    }
+    return true;
+  }
+
+  // dna in given geometry that is not smaller than the graph geometry
+  const std::string& save(const MetaData& meta)
+  {
+    auto& dna = save();
+    if (memcmp(&meta, &_meta, sizeof(MetaData)) == 0) return dna;
+    relayout(dna, meta, _layout);
+    return _layout;
+  }
+
+  // sparse genome in given geometry
+  const std::string& save_sparse(const MetaData& meta)
+  {
+    to_sparse(save(meta), _sparse);
+    return _sparse;
+  }
+
+  // smallest geometry holding both graphs, false if input or output differ
+  bool geometry(const Graph& other, MetaData& meta) const
+  {
+    if (_meta.input != other._meta.input) return false;
+    if (_meta.output != other._meta.output) return false;
+    meta = _meta;
+    meta.hidden = std::max(_meta.hidden, other._meta.hidden);
+    meta.links = std::max(_meta.links, other._meta.links);
+    return true;
+  }
+
+  // copy dna to larger geometry, node indices are kept (hidden nodes are
+  // last) and the inactive link source is moved to the new max nodes
+  void relayout(const std::string& in, const MetaData& meta, std::string& out) const
+  {
+    auto data = in.data();
+    auto& old = *(const MetaData*)data;
+    auto old_max = old.input + old.output + old.hidden;
+    auto max_nodes = meta.input + meta.output + meta.hidden;
+
+    // new nodes are inactive
+    out.assign(link_offset(meta, max_nodes, 0), 0);
+    auto dna = &out[0];
+    *(MetaData*)dna = meta;
+
+    // new links are inactive
+    auto links = (LinkData*)(dna + link_offset(meta, meta.input, 0));
+    auto links_size = (meta.output + meta.hidden) * meta.links;
+    for (auto i=0; i<links_size; i++) links[i].source = max_nodes;
+
+    for (auto i=old.input; i<old_max; i++)
+    {
+      *(NodeData*)(dna + node_offset(meta, i)) =
+      *(const NodeData*)(data + node_offset(old, i));
+
+      auto src = (const LinkData*)(data + link_offset(old, i, 0));
+      auto dst = (LinkData*)(dna + link_offset(meta, i, 0));
+      for (auto j=0; j<old.links; j++)
+      {
+        dst[j].weight = src[j].weight;
+        dst[j].source = src[j].source % (old_max + 1);
+        if (dst[j].source == old_max) dst[j].source = max_nodes;
+      }
+    }
+  }
+
+  // 1-point crossover at random byte with random split of its bits
+  void crossover_point(const char* pa, const char* pb, char* dna, uint32_t size)
+  {
+    auto offset = sizeof(MetaData);
+    auto index = _rng->uniform_int(offset, size-1);
+    memcpy(dna + offset, pa + offset, index - offset);
+    memcpy(dna + index, pb + index, size - index);
+
+    // get A and B bytes
+    uint8_t a = pa[index];
+    uint8_t b = pb[index];
+    auto bits = _rng->uniform_int(8); // 0-8 shared bits
+
+    // drop lower bits
+    a >>= 8-bits;
+    a <<= 8-bits;
+
+    // drop higher bits
+    b <<= bits;
+    b >>= bits;
+
+    // crossover higher and lower bits
+    dna[index] = a | b;
+  }
+
+  // k-point crossover at record boundaries, segments alternate between
+  // A and B
+  void crossover_points(const char* pa, const char* pb, char* dna, uint32_t size)
+  {
+    // node and link records have the same size
+    auto offset = sizeof(MetaData);
+    auto records = (size - offset) / sizeof(LinkData);
+    if (records == 0) return;
+
+    uint32_t points[CROSSOVER_POINTS + 1];
+    for (auto i=0; i<CROSSOVER_POINTS; i++)
+      points[i] = offset + _rng->uniform_int(records - 1) * sizeof(LinkData);
+    points[CROSSOVER_POINTS] = size;
+    std::sort(points, points + CROSSOVER_POINTS);
+
+    for (auto i=0; i<=CROSSOVER_POINTS; i++)
+    {
+      auto src = (i % 2) ? pb : pa;
+      memcpy(dna + offset, src + offset, points[i] - offset);
+      offset = points[i];
+    }
+  }
+
+  // uniform crossover of whole nodes, each node record and its links
+  // come from the same randomly chosen parent
+  void crossover_uniform(const char* pa, const char* pb, char* dna,
+                         const MetaData& meta)
+  {
+    auto nodes = meta.output + meta.hidden;
+    auto links_size = meta.links * sizeof(LinkData);
+    auto links = link_offset(meta, meta.input, 0);
+    auto offset = node_offset(meta, meta.input);
+
+    for (auto i=0; i<nodes; i+=32)
+    {
+      uint32_t mask = _rng->uniform_bits();
+      uint32_t size = std::min(nodes - i, 32u);
+
+      // node records
+      blend(pa + offset, pb + offset, dna + offset, mask, size);
+      offset += size * sizeof(NodeData);
+
+      // node links
+      for (auto j=0; j<size; j++, links += links_size)
+      {
+        auto src = (mask & (1u << j)) ? pb : pa;
+        memcpy(dna + links, src + links, links_size);
+      }
+    }
+  }
+
+  // copy 8-byte records from A or B when the record mask bit is set
+  void blend(const char* a, const char* b, char* dst, uint32_t mask,
+             uint32_t size)
+  {
+    auto i = 0;
+#if defined(__AVX2__)
+    for (; i+4<=size; i+=4, mask>>=4)
+    {
+      auto m = _mm256_set_epi64x(-(int64_t)((mask >> 3) & 1),
+                                 -(int64_t)((mask >> 2) & 1),
+                                 -(int64_t)((mask >> 1) & 1),
+                                 -(int64_t)(mask & 1));
+      auto x = _mm256_loadu_si256((const __m256i*)(a + i*8));
+      auto y = _mm256_loadu_si256((const __m256i*)(b + i*8));
+      _mm256_storeu_si256((__m256i*)(dst + i*8), _mm256_blendv_epi8(x, y, m));
+    }
+#elif defined(__SSE4_1__)
+    for (; i+2<=size; i+=2, mask>>=2)
+    {
+      auto m = _mm_set_epi64x(-(int64_t)((mask >> 1) & 1), -(int64_t)(mask & 1));
+      auto x = _mm_loadu_si128((const __m128i*)(a + i*8));
+      auto y = _mm_loadu_si128((const __m128i*)(b + i*8));
+      _mm_storeu_si128((__m128i*)(dst + i*8), _mm_blendv_epi8(x, y, m));
+    }
+#endif
+    for (; i<size; i++, mask>>=1)
+      memcpy(dst + i*8, ((mask & 1) ? b : a) + i*8, 8);
+  }
+
   int32_t to_int(float f) const
   {
     f /= DTYPE_PRECISION;
@@ -695,6 +1819,18 @@ public:
     return i * DTYPE_PRECISION;
   }
   
+  // dense genome bytes of geometry, 0 if it exceeds GENOME_LIMIT
+  static uint64_t genome_size(const MetaData& meta)
+  {
+    uint64_t nodes = (uint64_t)meta.input + meta.output + meta.hidden;
+    uint64_t stored = (uint64_t)meta.output + meta.hidden;
+    if (nodes * sizeof(NodeData) > GENOME_LIMIT) return 0;
+    if ((uint64_t)meta.links * sizeof(LinkData) > GENOME_LIMIT) return 0;
+    auto size = sizeof(MetaData) +
+                stored * (sizeof(NodeData) + meta.links * sizeof(LinkData));
+    return (size > GENOME_LIMIT) ? 0 : size;
+  }
+
   uint32_t node_offset(const MetaData& meta, uint32_t node) const
   {
     // input has virtual index and is not present in store
@@ -709,27 +1845,325 @@ public:
         + ((node - meta.input) * meta.links + link) * sizeof(LinkData);
   }
   
+  // use given random generator in graph and its nodes
+  void bind(RNG& rng)
+  {
+    _rng = &rng;
+    for (auto e: _nodes) e->_rng = &rng;
+  }
+
+  // bind input nodes to contiguous input buffer
+  void bind(uint32_t size)
+  {
+    _inputs.assign(size, 0);
+    for (auto i=0; i<size; i++) ((Input*)_nodes[i])->bind(&_inputs[i]);
+  }
+
+  // reuse node of given type released by clear or create new one
+  Node* alloc_node(int type)
+  {
+    auto& free = _free[type];
+    if (free.empty()) return new_node(type);
+    auto node_p = free.back();
+    free.pop_back();
+    node_p->recycle();
+    node_p->_rng = _rng;
+    return node_p;
+  }
+
   // create specific node when type != -1, or random node when type = -1,
   // NODE_INPUT is excluded in random type selection mode (type = -1)
   Node* new_node(int type = -1)
   {
-    if (type == -1) type = _rng.uniform_int(NODE_MINIMUM+1, NODE_MAXIMUM);
+    if (type == -1) type = _rng->uniform_int(NODE_MINIMUM+1, NODE_MAXIMUM);
     Node* node = nullptr;
     switch(type)
     {
-      case NODE_INPUT: node = new Input(_rng); break;
-      case NODE_ADD: node = new Add(_rng); break;
-      case NODE_MUL: node = new Mul(_rng); break;
+      case NODE_INPUT: node = new Input(*_rng); break;
+      case NODE_ADD: node = new Add(*_rng); break;
+      case NODE_MUL: node = new Mul(*_rng); break;
     }
     return node;
   }
   
   std::string _dna; // mutable container of *ALL* genes/features
+  std::string _sparse; // active genes of _dna
+  std::string _layout; // _dna in larger geometry used in crossover
+  std::vector<uint32_t> _dirty; // nodes updated since last save
+  bool _synced; // _dna layout matches nodes and links
   std::vector<Node*> _nodes; // [input..., output..., hidden...]
   std::vector<uint32_t> _nodes_index; // nodes store index
-  std::vector<std::vector<uint32_t>> _links_index; // links store index
+  std::vector<uint32_t> _links_index; // links store index of all nodes
+  std::vector<uint32_t> _links_offset; // node first link in _links_index
+  std::vector<uint32_t> _index; // store to rt node index used in load
+  std::vector<Node*> _free[NODE_MAXIMUM + 1]; // released nodes by type
+  std::vector<DTYPE> _inputs; // input values read by input nodes
+  const Optimizer* _optimizer; // weights update rule
+  uint32_t _step; // number of weight updates
+  DTYPE _baseline; // running mean reward
+  DTYPE _pending; // running mean reward including rewards since gradient
   MetaData _meta;
-  RNG& _rng;
+  RNG* _rng;
+};
+
+// search space growth policy, growth steps are reduced or refused when
+// the projected population memory or evaluation time exceeds the budget
+class Growth
+{
+public:
+  Growth(DTYPE usage = GROWTH_USAGE, DTYPE step = GROWTH_STEP,
+         uint64_t memory = MEMORY_BUDGET, double latency = LATENCY_BUDGET)
+  {
+    _usage = usage;
+    _step = step;
+    _memory = memory;
+    _latency = latency;
+  }
+
+  // estimated bytes of a graph with all nodes and links active
+  static uint64_t bytes(const Graph::MetaData& meta)
+  {
+    uint64_t nodes = meta.output + meta.hidden;
+    uint64_t links = nodes * meta.links;
+    uint64_t dna = sizeof(Graph::MetaData) + nodes * sizeof(Graph::NodeData) +
+                   links * sizeof(Graph::LinkData);
+    uint64_t link = sizeof(Node*) + 4 * sizeof(DTYPE);
+    return dna + nodes * sizeof(Add) + links * link;
+  }
+
+  // estimated evaluation time in new geometry, scaled by max links
+  static double latency(const Graph::MetaData& meta,
+                        const Graph::MetaData& next, double seconds)
+  {
+    double links = (meta.output + meta.hidden) * meta.links;
+    double next_links = (next.output + next.hidden) * next.links;
+    return (links > 0) ? seconds * next_links / links : seconds;
+  }
+
+  // geometry after growth given dna capacity use, number of graphs in
+  // memory and measured evaluation time, returns current geometry when
+  // growth is not needed or does not fit the budgets
+  Graph::MetaData grow(const Graph::MetaData& meta, DTYPE usage,
+                       uint32_t graphs, double seconds) const
+  {
+    if (!(usage > _usage)) return meta;
+
+    // halve growth step until the new geometry fits
+    for (auto step = _step; ; step /= 2)
+    {
+      auto next = meta;
+      next.hidden += meta.hidden * step;
+      next.links += meta.links * step;
+      if (next.hidden == meta.hidden && next.links == meta.links) break;
+
+      if (_memory > 0 && graphs * bytes(next) > _memory) continue;
+      if (_latency > 0 && latency(meta, next, seconds) > _latency) continue;
+      return next;
+    }
+    return meta;
+  }
+
+private:
+  DTYPE _usage;     // capacity use that triggers growth
+  DTYPE _step;      // relative growth per step
+  uint64_t _memory; // population memory budget
+  double _latency;  // graph evaluation time budget
+};
+
+// bounded LRU cache of fitness statistics keyed by graph hash
+class FitnessCache
+{
+public:
+  struct Entry
+  {
+    uint32_t count; // number of evaluations
+    DTYPE mean;     // mean fitness
+    double seconds; // mean evaluation time per sample
+  };
+
+  FitnessCache(uint32_t capacity = MEMO_CACHE_SIZE) : _capacity(capacity) {}
+
+  // find entry and mark it as recent, nullptr if not cached
+  const Entry* find(uint64_t hash)
+  {
+    auto it = _index.find(hash);
+    if (it == _index.end()) return nullptr;
+    _recent.splice(_recent.begin(), _recent, it->second);
+    return &it->second->second;
+  }
+
+  // add fitness and time to running means of the hash, evict the oldest
+  // if full
+  void insert(uint64_t hash, DTYPE fitness, double seconds = 0)
+  {
+    auto it = _index.find(hash);
+    if (it == _index.end())
+    {
+      if (_capacity == 0) return;
+      if (_index.size() >= _capacity)
+      {
+        _index.erase(_recent.back().first);
+        _recent.pop_back();
+      }
+      _recent.emplace_front(hash, Entry{0, 0, 0});
+      it = _index.emplace(hash, _recent.begin()).first;
+    }
+    else _recent.splice(_recent.begin(), _recent, it->second);
+
+    auto& entry = it->second->second;
+    entry.count++;
+    entry.mean += (fitness - entry.mean) / entry.count;
+    entry.seconds += (seconds - entry.seconds) / entry.count;
+  }
+
+  void clear()
+  {
+    _index.clear();
+    _recent.clear();
+  }
+
+  uint32_t size() const { return _index.size(); }
+
+private:
+  typedef std::list<std::pair<uint64_t, Entry>> Recent;
+  std::unordered_map<uint64_t, Recent::iterator> _index;
+  Recent _recent;
+  uint32_t _capacity;
+};
+
+// parent selection strategy over population of generational evolution
+class Selection
+{
+public:
+  typedef std::vector<std::pair<DTYPE, Graph*>> Population;
+
+  virtual ~Selection() {}
+
+  // true if population must be sorted by fitness, otherwise only the better
+  // half is partitioned from the weaker half with the best graph first
+  virtual bool ranked() const = 0;
+
+  // prepare draws from population once per generation
+  virtual void prepare(const Population& population) = 0;
+
+  // indices of two different parents
+  virtual void select(RNG& rng, uint32_t& a, uint32_t& b) const = 0;
+};
+
+// linear ranking, graphs are paired by rank and pair i of n has weight
+// n - i, first parent is the better and second the worse of its pair
+class RankSelection: public Selection
+{
+public:
+  virtual bool ranked() const { return true; }
+
+  virtual void prepare(const Population& population)
+  {
+    uint32_t pairs = population.size() / 2;
+    if (_table.size() == pairs) return;
+    std::vector<uint32_t> weights(pairs);
+    for (auto i=0; i<pairs; i++) weights[i] = pairs - i;
+    _table.build(weights.begin(), weights.end());
+  }
+
+  virtual void select(RNG& rng, uint32_t& a, uint32_t& b) const
+  {
+    a = 2 * _table.sample(rng);
+    b = 2 * _table.sample(rng) + 1;
+  }
+
+private:
+  AliasTable _table;
+};
+
+// best of size graphs drawn uniformly, NaN fitness is the worst
+class TournamentSelection: public Selection
+{
+public:
+  TournamentSelection(uint32_t size = TOURNAMENT_SIZE) : _size(std::max(size, 1u)) {}
+
+  virtual bool ranked() const { return false; }
+
+  virtual void prepare(const Population& population)
+  {
+    _fitness.resize(population.size());
+    for (auto i=0; i<population.size(); i++)
+    {
+      auto f = population[i].first;
+      _fitness[i] = std::isnan(f) ? -INFINITY : f;
+    }
+  }
+
+  virtual void select(RNG& rng, uint32_t& a, uint32_t& b) const
+  {
+    a = tournament(rng, _fitness.size());
+    b = tournament(rng, a);
+  }
+
+private:
+  // tournament without graph at index skip
+  uint32_t tournament(RNG& rng, uint32_t skip) const
+  {
+    uint32_t size = _fitness.size() - (skip < _fitness.size());
+    uint32_t best = 0;
+    for (auto i=0; i<_size; i++)
+    {
+      uint32_t x = rng.uniform_int(size - 1);
+      if (x >= skip) x++;
+      if (i == 0 || _fitness[x] > _fitness[best]) best = x;
+    }
+    return best;
+  }
+
+  uint32_t _size;
+  std::vector<DTYPE> _fitness;
+};
+
+// per-thread evaluation state
+struct Context
+{
+  RNG rng;        // training and breeding
+  RNG validation; // validation, apart from training streams
+};
+
+// graph evaluation result on a data split
+struct Validation
+{
+  DTYPE accuracy;   // mean reward
+  uint32_t samples; // number of samples
+  double seconds;   // wall time
+};
+
+// population structure in one generation
+struct Statistics
+{
+  uint64_t generation;  // generation number
+  uint32_t population;  // number of graphs
+  DTYPE fitness;        // mean fitness
+  DTYPE best;           // best fitness
+  DTYPE nodes;          // mean active nodes (without inputs)
+  DTYPE links;          // mean active links
+  DTYPE depth;          // mean depth
+  uint32_t max_depth;   // max depth
+  DTYPE fanin;          // mean node fan-in
+  uint32_t max_fanin;   // max node fan-in
+  uint32_t fanins[FANIN_BUCKETS]; // nodes with fan-in 0, 1, 2-3, 4-7, ...
+  uint32_t types[NODE_MAXIMUM + 1]; // nodes of each type
+  DTYPE usage;          // mean dna capacity use
+  DTYPE duplicates;     // fraction of graphs identical to another graph
+  uint32_t hidden;      // max hidden nodes
+  uint32_t capacity;    // max links per node
+};
+
+typedef std::function<void(const Statistics&)> StatisticsSink;
+
+// graph not dominated in both fitness and cost by another graph
+struct Pareto
+{
+  DTYPE fitness;     // fitness without cost
+  DTYPE cost;        // evaluation cost
+  uint64_t hash;     // graph hash
+  std::string graph; // sparse genome
 };
 
 class NeuroEvolution
@@ -738,97 +2172,1043 @@ public:
   NeuroEvolution(int input, int output, int max_hidden, int max_links, int size)
   {
     _epoch = 1000;
+    _batch = BATCH_SIZE;
+    _pool = nullptr;
     _objective = 0.0;
+    _memo = 0;
+    _sparse = false;
+    _evaluations = 0;
+    _duplicates = 0;
+    _mutation = Mutation();
+    _crossover = CROSSOVER_POINT;
+    _latency = 0;
+    _generation = 0;
+    _stats_period = 0;
+    _cost_type = COST_LINKS;
+    _cost_weight = 0;
+    _threads = 1;
+    _steady = false;
+    _racing = 0;
+    _races = 0;
+    _threshold = NAN;
+    _survivor = NAN;
+    _common = false;
+    _budget = 0;
+    _cancel = nullptr;
+    _optimizer = new SGD();
+    _selection = new RankSelection();
     size = std::max(4, (size/2)*2);
 
     for (auto i=0; i<size; i++)
     {
       _population.emplace_back(NAN, 
       new Graph(input, output, max_hidden, max_links, _rng));
+      _population.back().second->set_optimizer(*_optimizer);
     }
   }
 
   virtual ~NeuroEvolution()
   {
     for (auto& e: _population) delete e.second;
+    for (auto e: _spare) delete e;
+    for (auto e: _contexts) delete e;
+    delete _optimizer;
+    delete _selection;
+    delete _pool;
   }
 
+  // set weights update rule of all graphs, takes ownership
+  void set_optimizer(Optimizer* opt)
+  {
+    if (opt == nullptr) return;
+    for (auto& e: _population) e.second->set_optimizer(*opt);
+    delete _optimizer;
+    _optimizer = opt;
+  }
+
+  // set parent selection strategy of generational evolution, takes ownership
+  void set_selection(Selection* selection)
+  {
+    if (selection == nullptr) return;
+    delete _selection;
+    _selection = selection;
+  }
+
+  // load graph into the weakest slot, evaluated in next run
   void seed(const std::string& graph)
   {
     _population.back().second->load(graph);
+    _population.back().first = NAN;
     _rng.seed();
+    for (auto e: _contexts)
+    {
+      e->rng.seed();
+      e->validation.seed();
+    }
+  }
+
+  // threads evaluating and breeding the population in run
+  void set_threads(int threads)
+  {
+    _threads = std::max(threads, 1);
+  }
+
+  int threads() { return _threads; }
+
+  // generations per run
+  void set_epoch(uint32_t epoch)
+  {
+    _epoch = std::max(epoch, 1u);
+  }
+
+  uint32_t epoch() { return _epoch; }
+
+  // training samples per episode
+  void set_batch(uint32_t batch)
+  {
+    _batch = std::max(batch, 1u);
+  }
+
+  uint32_t batch() { return _batch; }
+
+  // resize population to even size of at least 4, the weakest graphs are
+  // dropped or new random graphs of current geometry are added
+  void set_size(uint32_t size)
+  {
+    size = std::max(4u, (size/2)*2);
+    while (_population.size() > size)
+    {
+      delete _population.back().second;
+      _population.pop_back();
+    }
+    auto meta = _population.front().second->_meta;
+    while (_population.size() < size)
+    {
+      _population.emplace_back(NAN,
+      new Graph(meta.input, meta.output, meta.hidden, meta.links, _rng));
+      _population.back().second->set_optimizer(*_optimizer);
+    }
+  }
+
+  uint32_t size() { return _population.size(); }
+
+  // steady state instead of generational evolution
+  void set_steady(bool steady)
+  {
+    _steady = steady;
   }
   
+  // best graph in sparse genome format (accepted by seed and load)
   std::string best() 
   {
-    return _population.front().second->save();
+    return _population.front().second->save_sparse();
   }
 
+  // best fitness reduced by weighted cost
   DTYPE fitness() { return _population.front().first; }
   
   DTYPE objective() { return _objective; }
 
-  void run()
+  // create graph from dna with population optimizer, nullptr if invalid
+  Graph* create(const std::string& graph)
+  {
+    auto g = new Graph(0,0,0,0,_rng);
+    g->set_optimizer(*_optimizer);
+    if (g->load(graph) == false)
+    {
+      delete g;
+      g = nullptr;
+    }
+    return g;
+  }
+
+  // fine-tune graph on one training batch sharded across threads,
+  // returns mean batch reward
+  DTYPE tune(Graph& g, int threads)
+  {
+    return train(g, _batch, threads);
+  }
+
+  // evaluate graph without training on entire data split in chunks
+  // spread across threads, each with own activation state and validation
+  // RNG, so training streams are not advanced
+  Validation validate(const Graph& g, int threads, int split = SPLIT_TEST)
+  {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t size = samples(split);
+    uint32_t chunks = (size + VALIDATION_CHUNK - 1) / VALIDATION_CHUNK;
+    threads = std::max(1, threads);
+
+    // replicas with per-thread validation RNG
+    auto& pool = thread_pool(threads);
+    std::vector<Graph*> replicas(threads);
+    std::vector<DTYPE> rewards(chunks, 0);
+    for (auto i=0; i<threads; i++) replicas[i] = g.replica(context(i).validation);
+
+    pool.run(chunks, [&](uint32_t task, int thread)
+    {
+      auto& replica = *replicas[thread];
+      auto begin = task * VALIDATION_CHUNK;
+      auto end = std::min(size, begin + VALIDATION_CHUNK);
+      DTYPE R = 0;
+      for (auto i=begin; i<end; i++) R += sample(replica, split, i);
+      rewards[task] = R;
+    });
+
+    DTYPE R = 0;
+    for (auto e: rewards) R += e;
+    for (auto e: replicas) delete e;
+
+    Validation v;
+    v.accuracy = (size > 0) ? R / size : NAN;
+    v.samples = size;
+    v.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    return v;
+  }
+
+  // evaluate graph stored in dna, NAN accuracy if dna is invalid
+  Validation validate(const std::string& graph, int threads,
+                      int split = SPLIT_TEST)
+  {
+    auto g = create(graph);
+    if (g == nullptr) return Validation{NAN, 0, 0};
+    auto v = validate(*g, threads, split);
+    delete g;
+    return v;
+  }
+
+  // send population statistics to sink every period generations (0 is never)
+  void set_statistics(uint32_t period, const StatisticsSink& sink)
+  {
+    _stats_period = period;
+    _stats_sink = sink;
+  }
+
+  // structural statistics of current population
+  Statistics statistics() const
+  {
+    Statistics s;
+    memset(&s, 0, sizeof(s));
+    s.generation = _generation;
+    s.population = _population.size();
+    s.best = -INFINITY;
+
+    std::vector<uint64_t> hashes;
+    uint32_t nodes = 0;
+    for (auto& e: _population)
+    {
+      auto& g = *e.second;
+      s.fitness += e.first;
+      s.best = std::max(s.best, e.first);
+      s.nodes += g._nodes.size() - g._meta.input;
+      s.links += g.size();
+      s.usage += (DTYPE) g.size() / std::max(g.capacity(), 1u);
+
+      auto depth = g.depth();
+      s.depth += depth;
+      s.max_depth = std::max(s.max_depth, depth);
+
+      for (auto i=g._meta.input; i<g._nodes.size(); i++)
+      {
+        uint32_t fanin = g._nodes[i]->_input.size();
+        uint32_t bucket = 0;
+        while (fanin >> bucket && bucket < FANIN_BUCKETS - 1) bucket++;
+        s.fanins[bucket]++;
+        s.fanin += fanin;
+        s.max_fanin = std::max(s.max_fanin, fanin);
+        s.types[g._nodes[i]->type()]++;
+        nodes++;
+      }
+      hashes.push_back(g.hash());
+    }
+
+    // identical graphs beyond the first of each hash
+    std::sort(hashes.begin(), hashes.end());
+    auto unique = std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+
+    auto size = std::max(s.population, 1u);
+    s.fitness /= size;
+    s.nodes /= size;
+    s.links /= size;
+    s.usage /= size;
+    s.depth /= size;
+    s.fanin /= std::max(nodes, 1u);
+    s.duplicates = (DTYPE)(hashes.size() - unique) / size;
+    if (_population.size())
+    {
+      s.hidden = _population.front().second->_meta.hidden;
+      s.capacity = _population.front().second->_meta.links;
+    }
+    return s;
+  }
+
+  // reduce fitness by weight * cost of given type (weight 0 is no cost)
+  void set_cost(int type, DTYPE weight)
+  {
+    _cost_type = type;
+    _cost_weight = weight;
+  }
+
+  // graphs with best fitness for their cost, in ascending cost order
+  // (empty unless cost weight is set)
+  const std::vector<Pareto>& pareto() const { return _pareto; }
+
+  // number of evaluated graphs since creation
+  uint64_t evaluations() { return _evaluations; }
+
+  // number of evaluated graphs identical to a recently evaluated graph
+  uint64_t duplicates() { return _duplicates; }
+
+  // abort training episodes once mean reward + z * standard error is below
+  // the worst survivor of the last generation (z = 0 is never)
+  void set_racing(DTYPE z)
+  {
+    _racing = z;
+  }
+
+  // number of episodes aborted by racing
+  uint64_t races() { return _races; }
+
+  // successive halving, all graphs are evaluated on batches[0] samples and
+  // ratios[i] of the best graphs of rung i are evaluated again on
+  // batches[i+1] samples (missing ratios are PROMOTION_RATIO), graphs are
+  // ranked by the highest rung they reached, empty batches is one rung of
+  // _batch samples
+  void set_fidelity(const std::vector<uint32_t>& batches,
+                    const std::vector<DTYPE>& ratios)
+  {
+    _fidelity = batches;
+    _promotion = ratios;
+  }
+
+  // evaluate the whole generation on one common training batch drawn per
+  // generation instead of a random batch per graph
+  void set_common(bool common)
+  {
+    _common = common;
+  }
+
+  // evolve population for _epoch generations (or as many births in
+  // steady state) and grow search space, stops at a generation boundary
+  // once budget seconds passed (0 is no limit) or cancel is set, returns
+  // number of generations
+  uint64_t run(double budget = 0, const std::atomic<bool>* cancel = nullptr)
+  {
+    auto generation = _generation;
+    _start = std::chrono::steady_clock::now();
+    _budget = budget;
+    _cancel = cancel;
+    if (_steady) steady();
+    else generations();
+    _budget = 0;
+    _cancel = nullptr;
+    grow();
+    return _generation - generation;
+  }
+
+protected:
+  // generational evolution, the weak half of the population is replaced
+  // by offspring of the entire population in each generation
+  void generations()
   {
-    // probability distribution for crossover selection
     auto size = _population.size();
-    std::vector<int> crossover(size/2);
-    std::vector<Graph*> offspring(size/2);
-    for (auto i=0; i<size/2; i++) crossover[i] = size/2 - i;
+    std::vector<uint32_t> parents(size);
+    std::vector<const std::string*> genomes(size);
+    std::vector<uint8_t> offspring(size/2);
+    std::vector<double> seconds(size);
+    std::vector<uint32_t> order(size), rungs(size);
+    std::vector<DTYPE> raw(size);
+    std::vector<std::tuple<uint32_t, DTYPE, Graph*, DTYPE>> ranking(size);
+    std::vector<uint32_t> common;
+
+    // offspring are decoded into recycled graphs
+    while (_spare.size() < size/2) _spare.push_back(new Graph(0,0,0,0,_rng));
+
+    // tasks use random generator of the thread they run on
+    auto& pool = thread_pool(_threads);
+    context(pool.size() - 1);
     
     // run epoch
-    for (auto s=0; s<_epoch; s++)
+    for (auto s=0; s<_epoch && stopped() == false; s++)
     {
-      // evaluate all elements
-      for (auto& e: _population) e.first = episode(*e.second);
+      // evaluate all elements on the first rung and promote the best of
+      // each rung to the next, racing against last generation survivors
+      _threshold = (_racing > 0) ? _survivor : NAN;
+      auto levels = std::max<size_t>(_fidelity.size(), 1);
+      uint32_t count = size;
+      if (_common)
+      {
+        uint32_t top = _batch;
+        if (_fidelity.size()) top = *std::max_element(_fidelity.begin(), _fidelity.end());
+        top = std::min(top, samples(SPLIT_TRAIN));
+        auto indices = draw(top, _rng);
+        common.assign(indices, indices + top);
+      }
+      for (auto i=0; i<size; i++) order[i] = i;
+      for (auto i=0; i<size; i++) seconds[i] = 0;
+      for (auto r=0; r<levels; r++)
+      {
+        auto batch = _fidelity.empty() ? _batch : _fidelity[r];
+        if (r > 0)
+        {
+          auto ratio = (r - 1 < _promotion.size()) ? _promotion[r - 1]
+                                                   : PROMOTION_RATIO;
+          auto next = std::min<uint32_t>(count, ceil(count * ratio));
+          if (next == 0) break;
+          std::nth_element(order.begin(), order.begin() + next - 1,
+          order.begin() + count, [&](uint32_t x, uint32_t y)
+          {
+            return _population[x].first > _population[y].first;
+          });
+          count = next;
+        }
+
+        if (_common)
+        {
+          evaluate(order.data(), count, common.data(),
+                   std::min<uint32_t>(batch, common.size()), seconds, raw);
+        }
+        else pool.run(count, [&](uint32_t task, int thread)
+        {
+          auto slot = order[task];
+          auto& e = _population[slot];
+          e.second->bind(context(thread).rng);
+          auto start = std::chrono::steady_clock::now();
+          e.first = evaluate(*e.second, batch, &raw[slot]);
+          auto end = std::chrono::steady_clock::now();
+          seconds[slot] += std::chrono::duration<double>(end - start).count();
+        });
+        for (auto i=0; i<count; i++) rungs[order[i]] = r;
+      }
+      _threshold = NAN;
+      _latency = 0;
+      for (auto e: seconds) _latency += e / size;
       
-      // sort population by rewards in descending order
-      std::sort(_population.rbegin(), _population.rend());
+      // order population by highest rung and rewards in descending order,
+      // fully sorted only if selection depends on rank
+      for (auto i=0; i<size; i++)
+      {
+        ranking[i] = std::make_tuple(rungs[i], _population[i].first,
+                                     _population[i].second, raw[i]);
+      }
+      if (_selection->ranked()) std::sort(ranking.rbegin(), ranking.rend());
+      else
+      {
+        auto better = std::greater<std::tuple<uint32_t, DTYPE, Graph*, DTYPE>>();
+        std::nth_element(ranking.begin(), ranking.begin() + size/2 - 1,
+                         ranking.end(), better);
+        std::iter_swap(ranking.begin(), std::min_element(ranking.begin(),
+                       ranking.begin() + size/2, better));
+      }
+      for (auto i=0; i<size; i++)
+      {
+        _population[i].first = std::get<1>(ranking[i]);
+        _population[i].second = std::get<2>(ranking[i]);
+      }
+      _survivor = std::get<3>(ranking[size/2 - 1]);
+
+      // report population structure
+      _generation++;
+      if (_stats_period > 0 && _generation % _stats_period == 0 && _stats_sink)
+      {
+        _stats_sink(statistics());
+      }
 
-      // create new generation offspring from entire population
+      // select parents from entire population
+      _selection->prepare(_population);
       for (auto i=0; i<size/2; i++)
       {
-        auto M = _rng.discrete_choice(crossover.begin(), crossover.end());
-        auto F = _rng.discrete_choice(crossover.begin(), crossover.end());
-        auto male = _population[2*M].second;
-        auto female = _population[2*F + 1].second;
-        offspring[i] = male->crossover(*female);
+        _selection->select(_rng, parents[2*i], parents[2*i + 1]);
       }
 
+      // parent genomes in common geometry, read only while breeding
+      auto meta = _population.front().second->_meta;
+      for (auto& e: _population)
+      {
+        meta.hidden = std::max(meta.hidden, e.second->_meta.hidden);
+        meta.links = std::max(meta.links, e.second->_meta.links);
+      }
+      pool.run(size, [&](uint32_t task, int thread)
+      {
+        auto& g = *_population[task].second;
+        genomes[task] = nullptr;
+        if (g._meta.input != meta.input || g._meta.output != meta.output) return;
+        genomes[task] = _sparse ? &g.save_sparse(meta) : &g.save(meta);
+      });
+
+      // create new generation offspring
+      pool.run(size/2, [&](uint32_t task, int thread)
+      {
+        auto& child = *_spare[task];
+        auto A = genomes[parents[2*task]];
+        auto B = genomes[parents[2*task + 1]];
+        child.bind(context(thread).rng);
+        offspring[task] = A && B &&
+        (_sparse ? child.recombine_sparse(*A, *B, *_optimizer, _mutation)
+                 : child.recombine(*A, *B, *_optimizer, _mutation, _crossover));
+      });
+
       // replace the weak half of the population with the new offspring
       for (auto i=0; i<size/2; i++)
       {
-        if (offspring[i] != nullptr)
+        if (offspring[i])
         {
-          delete _population[size - i - 1].second;
-          _population[size - i - 1].second = offspring[i];
+          std::swap(_population[size - i - 1].second, _spare[i]);
         }
       }
     }
 
+  }
+
+  // steady state evolution without generation barriers, each task breeds
+  // one child from tournament parents and replaces a tournament loser,
+  // population slots are locked one at a time
+  void steady()
+  {
+    auto size = _population.size();
+    auto& pool = thread_pool(_threads);
+    auto threads = pool.size();
+    context(threads - 1);
+    while (_spare.size() < threads) _spare.push_back(new Graph(0,0,0,0,_rng));
+    std::vector<std::mutex> locks(size);
+    std::vector<std::string> genomes(2 * threads), sparse(2 * threads);
+    std::vector<double> seconds(threads, 0);
+    std::vector<uint32_t> births(threads, 0);
+    std::atomic<uint32_t> started(0);
+
+    // evaluate new population
+    pool.run(size, [&](uint32_t task, int thread)
+    {
+      auto& e = _population[task];
+      if (!std::isnan(e.first)) return;
+      e.second->bind(context(thread).rng);
+      e.first = evaluate(*e.second, _batch);
+    });
+
+    // slot fitness read under slot lock, NaN is the worst
+    auto score = [&](uint32_t slot)
+    {
+      std::lock_guard<std::mutex> lock(locks[slot]);
+      auto f = _population[slot].first;
+      return std::isnan(f) ? -INFINITY : f;
+    };
+
+    pool.run(_epoch * size / 2, [&](uint32_t task, int thread)
+    {
+      if (stopped()) return;
+      started++;
+      auto& rng = context(thread).rng;
+      auto& child = *_spare[thread];
+      child.bind(rng);
+
+      // binary tournament parents, copy of their genomes
+      std::string* dna = &genomes[2 * thread];
+      for (auto i=0; i<2; i++)
+      {
+        uint32_t x = rng.uniform_int(size - 1);
+        uint32_t y = rng.uniform_int(size - 1);
+        auto slot = (score(x) >= score(y)) ? x : y;
+        std::lock_guard<std::mutex> lock(locks[slot]);
+        dna[i] = _population[slot].second->save();
+      }
+
+      // common geometry
+      auto& a = *(const Graph::MetaData*)dna[0].data();
+      auto& b = *(const Graph::MetaData*)dna[1].data();
+      if (a.input != b.input || a.output != b.output) return;
+      auto meta = a;
+      meta.hidden = std::max(a.hidden, b.hidden);
+      meta.links = std::max(a.links, b.links);
+      for (auto i=0; i<2; i++)
+      {
+        if (memcmp(dna[i].data(), &meta, sizeof(meta)) == 0) continue;
+        child.relayout(dna[i], meta, sparse[2 * thread + i]);
+        dna[i].swap(sparse[2 * thread + i]);
+      }
+
+      // breed and evaluate child
+      bool valid;
+      if (_sparse)
+      {
+        child.to_sparse(dna[0], sparse[2 * thread]);
+        child.to_sparse(dna[1], sparse[2 * thread + 1]);
+        valid = child.recombine_sparse(sparse[2 * thread], sparse[2 * thread + 1],
+                                       *_optimizer, _mutation);
+      }
+      else valid = child.recombine(dna[0], dna[1], *_optimizer, _mutation, _crossover);
+      if (valid == false) return;
+
+      auto start = std::chrono::steady_clock::now();
+      auto f = evaluate(child, _batch);
+      auto end = std::chrono::steady_clock::now();
+      seconds[thread] += std::chrono::duration<double>(end - start).count();
+      births[thread]++;
+
+      // replace binary tournament loser if the child is not worse
+      uint32_t x = rng.uniform_int(size - 1);
+      uint32_t y = rng.uniform_int(size - 1);
+      auto slot = (score(x) <= score(y)) ? x : y;
+      std::lock_guard<std::mutex> lock(locks[slot]);
+      auto& e = _population[slot];
+      if (std::isnan(e.first) || f >= e.first)
+      {
+        e.first = f;
+        std::swap(e.second, _spare[thread]);
+      }
+    });
+
+    // mean child evaluation time
+    double time = 0;
+    uint32_t count = 0;
+    for (auto i=0; i<threads; i++)
+    {
+      time += seconds[i];
+      count += births[i];
+    }
+    if (count > 0) _latency = time / count;
+
+    // sort population by rewards in descending order
+    std::sort(_population.rbegin(), _population.rend());
+
+    // report population structure
+    auto generation = _generation;
+    _generation += (started + size/2 - 1) / (size/2);
+    if (_stats_period > 0 && _stats_sink &&
+        _generation / _stats_period != generation / _stats_period)
+    {
+      _stats_sink(statistics());
+    }
+  }
+
+  // run cancelled or out of time budget (thread safe)
+  bool stopped() const
+  {
+    if (_cancel != nullptr && *_cancel) return true;
+    if (_budget <= 0) return false;
+    auto time = std::chrono::steady_clock::now() - _start;
+    return std::chrono::duration<double>(time).count() >= _budget;
+  }
+
+  // increase search space within memory and latency budgets
+  void grow()
+  {
     // calculate dna capacity
     auto capacity = (float) _population.front().second->size() / 
                     _population.front().second->capacity();
 
-    // increase search space
-    if (capacity > 0.5)
+    auto& meta = _population.front().second->_meta;
+    auto next = _growth.grow(meta, capacity, _population.size() + _spare.size(),
+                             _latency);
+    if (memcmp(&next, &meta, sizeof(next)))
     {
-      auto meta = _population.front().second->_meta;
-      meta.hidden *= 2; 
-      meta.links *= 2; 
-      for (auto& e: _population) e.second->_meta = meta;
+      for (auto& e: _population) e.second->_meta = next;
     }
   }
 
-protected:
-  // train episode that updates graph weights and returns graph reward
-  virtual DTYPE episode(Graph& g) = 0;
+  // number of samples in data split
+  virtual uint32_t samples(int split) { return 0; }
+
+  // run graph on sample from data split and return its reward
+  virtual DTYPE sample(Graph& g, int split, uint32_t index) { return 0; }
+
+  // decode normalized inputs of sample from data split once for all graphs
+  // evaluated on it, false if sample must be run by each graph instead
+  virtual bool input(int split, uint32_t index, float* data) { return false; }
+
+  // reward of graph with reset state and inputs of sample already set
+  virtual DTYPE output(Graph& g, int split, uint32_t index) { return 0; }
+
+  // train episode on batch samples that updates graph weights and returns
+  // graph reward
+  virtual DTYPE episode(Graph& g, uint32_t batch)
+  {
+    return train(g, batch);
+  }
+
+  // train graph on random training batch, sharded across threads when
+  // threads > 1 (gradients of per-thread replicas are reduced before
+  // update), returns mean batch reward
+  DTYPE train(Graph& g, uint32_t batch, int threads = 1)
+  {
+    batch = std::min(batch, samples(SPLIT_TRAIN));
+    if (batch == 0) return 0;
+    auto indices = draw(batch, *g._rng);
+
+    // single thread
+    if (threads <= 1 || batch < threads)
+    {
+      auto R = std::isnan(_threshold) ? learn(g, indices, batch)
+                                      : race(g, indices, batch);
+      g.update();
+      return R / batch;
+    }
+
+    // replicas with own RNG and activation state
+    auto& pool = thread_pool(threads);
+    std::vector<Graph*> replicas(threads);
+    std::vector<DTYPE> rewards(threads, 0);
+    for (auto i=0; i<threads; i++) replicas[i] = g.replica(context(i).rng);
+
+    // train replicas on batch shards
+    pool.run(threads, [&](uint32_t task, int thread)
+    {
+      auto begin = (uint64_t)batch * task / threads;
+      auto end = (uint64_t)batch * (task + 1) / threads;
+      rewards[task] = learn(*replicas[task], indices + begin, end - begin);
+    });
+
+    // reduce gradients and update shared weights
+    g.reduce(replicas.data(), threads);
+    g.update();
+
+    DTYPE R = 0;
+    for (auto i=0; i<threads; i++)
+    {
+      R += rewards[i];
+      delete replicas[i];
+    }
+    return R / batch;
+  }
+
+  // accumulate gradients over samples, returns sum of rewards
+  DTYPE learn(Graph& g, const uint32_t* indices, uint32_t size)
+  {
+    DTYPE R = 0;
+    for (auto i=0; i<size; i++)
+    {
+      auto r = sample(g, SPLIT_TRAIN, indices[i]);
+      g.reward(r);
+      g.gradient();
+      R += r;
+    }
+    return R;
+  }
+
+  // accumulate gradients until the upper confidence bound of mean reward
+  // drops below _threshold, size is set to the number of used samples,
+  // returns sum of rewards
+  DTYPE race(Graph& g, const uint32_t* indices, uint32_t& size)
+  {
+    DTYPE R = 0;
+    double mean = 0, m2 = 0;
+    for (uint32_t i=0; i<size; i++)
+    {
+      auto r = sample(g, SPLIT_TRAIN, indices[i]);
+      g.reward(r);
+      g.gradient();
+      R += r;
+
+      // running variance
+      auto n = i + 1;
+      auto delta = r - mean;
+      mean += delta / n;
+      m2 += delta * (r - mean);
+
+      if (n % RACE_CHUNK == 0 && n < size)
+      {
+        auto bound = mean + _racing * sqrt(m2 / (n - 1) / n);
+        if (bound < _threshold)
+        {
+          size = n;
+          _races++;
+          raced() = n;
+          break;
+        }
+      }
+    }
+    return R;
+  }
+
+  // samples of the last episode of the calling thread if it was aborted
+  // by racing, 0 otherwise
+  static uint32_t& raced()
+  {
+    static thread_local uint32_t samples = 0;
+    return samples;
+  }
+
+  // random training samples without replacement (partial shuffle of
+  // per-thread sample order, any permutation is a valid start)
+  const uint32_t* draw(uint32_t batch, RNG& rng)
+  {
+    static thread_local std::vector<uint32_t> training;
+    uint32_t size = samples(SPLIT_TRAIN);
+    if (training.size() != size)
+    {
+      training.resize(size);
+      for (auto i=0; i<size; i++) training[i] = i;
+    }
+    batch = std::min(batch, size);
+    for (auto i=0; i<batch; i++)
+    {
+      std::swap(training[i], training[rng.uniform_int(i, size - 1)]);
+    }
+    return training.data();
+  }
+
+  // pool of given size, recreated on size change
+  ThreadPool& thread_pool(int threads)
+  {
+    if (_pool == nullptr || _pool->size() != threads)
+    {
+      delete _pool;
+      _pool = new ThreadPool(threads);
+    }
+    return *_pool;
+  }
+
+  // per-thread context, created on demand
+  Context& context(int thread)
+  {
+    while (_contexts.size() <= thread) _contexts.push_back(new Context());
+    return *_contexts[thread];
+  }
+
+  // graph evaluation cost, links reaching an output, nodes or seconds
+  // per training sample
+  virtual DTYPE cost(const Graph& g, double seconds)
+  {
+    switch (_cost_type)
+    {
+      case COST_NODES: return g._nodes.size() - g._meta.input;
+      case COST_TIME: return seconds;
+      default: return g.active_size();
+    }
+  }
+
+  // fitness reduced by weighted cost, runs episode on batch samples, a graph
+  // already evaluated _memo times on that batch size keeps its cached mean
+  // and trains on MEMO_BATCH of the samples, updates pareto front, fitness
+  // without cost is stored in raw (thread safe)
+  DTYPE evaluate(Graph& g, uint32_t batch, DTYPE* raw = nullptr)
+  {
+    // episode rewards are collected before the graph is updated, so they
+    // belong to the hash of its weights at the start
+    auto hash = g.hash();
+    auto key = hash ^ (batch * 0x9E3779B97F4A7C15ULL);
+    DTYPE fitness;
+    double seconds;
+    bool memo = false;
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      auto entry = _cache.find(key);
+      if (entry != nullptr && _memo > 0 && entry->count >= _memo)
+      {
+        fitness = entry->mean;
+        seconds = entry->seconds;
+        memo = true;
+      }
+    }
+
+    // memoized graphs still train, partial estimates of shortened or raced
+    // episodes are not cached
+    raced() = 0;
+    auto size = memo ? std::max<uint32_t>(1, ceil(batch * MEMO_BATCH)) : batch;
+    auto start = std::chrono::steady_clock::now();
+    auto reward = episode(g, size);
+    auto end = std::chrono::steady_clock::now();
+    bool cache = false;
+    if (memo == false)
+    {
+      // time per sample the episode trained on
+      auto used = raced() ? raced() : size;
+      if (samples(SPLIT_TRAIN)) used = std::min(used, samples(SPLIT_TRAIN));
+      fitness = reward;
+      seconds = std::chrono::duration<double>(end - start).count();
+      seconds /= std::max(used, 1u);
+      cache = (raced() == 0);
+    }
+    if (raw != nullptr) *raw = fitness;
+    return record(g, hash, batch, fitness, seconds, cache);
+  }
+
+  // train graphs in population slots on the same batch samples, each task
+  // runs a group of graphs sample by sample so decoded inputs are shared
+  // and stay in cache, sets slot fitness and raw fitness without cost and
+  // adds slot evaluation time
+  void evaluate(const uint32_t* slots, uint32_t count, const uint32_t* indices,
+                uint32_t batch, std::vector<double>& seconds,
+                std::vector<DTYPE>& raw)
+  {
+    auto& pool = thread_pool(_threads);
+    auto inputs = _population.front().second->_meta.input;
+    auto groups = (count + COMMON_GROUP - 1) / COMMON_GROUP;
+
+    pool.run(groups, [&](uint32_t task, int thread)
+    {
+      static thread_local std::vector<float> data;
+      data.resize(inputs);
+      Graph* graphs[COMMON_GROUP];
+      uint64_t hashes[COMMON_GROUP];
+      DTYPE rewards[COMMON_GROUP];
+      double times[COMMON_GROUP];
+      auto begin = task * COMMON_GROUP;
+      auto size = std::min<uint32_t>(COMMON_GROUP, count - begin);
+      for (auto i=0; i<size; i++)
+      {
+        graphs[i] = _population[slots[begin + i]].second;
+        graphs[i]->bind(context(thread).rng);
+        hashes[i] = graphs[i]->hash();
+        rewards[i] = 0;
+        times[i] = 0;
+      }
+
+      // each graph is charged its own work and an equal share of decoding
+      typedef std::chrono::steady_clock Clock;
+      auto last = Clock::now();
+      for (auto j=0; j<batch; j++)
+      {
+        bool shared = input(SPLIT_TRAIN, indices[j], data.data());
+        auto now = Clock::now();
+        auto decode = std::chrono::duration<double>(now - last).count() / size;
+        last = now;
+        for (auto i=0; i<size; i++)
+        {
+          auto& g = *graphs[i];
+          DTYPE r;
+          if (shared)
+          {
+            g.reset();
+            g.set_inputs(data.data(), inputs);
+            r = output(g, SPLIT_TRAIN, indices[j]);
+          }
+          else r = sample(g, SPLIT_TRAIN, indices[j]);
+          g.reward(r);
+          g.gradient();
+          rewards[i] += r;
+
+          now = Clock::now();
+          times[i] += decode + std::chrono::duration<double>(now - last).count();
+          last = now;
+        }
+      }
+      for (auto i=0; i<size; i++)
+      {
+        graphs[i]->update();
+        auto now = Clock::now();
+        times[i] += std::chrono::duration<double>(now - last).count();
+        last = now;
+      }
+
+      for (auto i=0; i<size; i++)
+      {
+        auto slot = slots[begin + i];
+        auto fitness = (batch > 0) ? rewards[i] / batch : 0;
+        seconds[slot] += times[i];
+        raw[slot] = fitness;
+        _population[slot].first = record(*graphs[i], hashes[i], batch, fitness,
+                                          times[i] / std::max(batch, 1u), true);
+      }
+    });
+  }
+
+  // fitness of graph with given hash reduced by weighted cost of seconds
+  // per sample, counts the evaluation, caches fitness if cache and updates
+  // pareto front
+  DTYPE record(Graph& g, uint64_t hash, uint32_t batch, DTYPE fitness,
+               double seconds, bool cache)
+  {
+    auto key = hash ^ (batch * 0x9E3779B97F4A7C15ULL);
+    auto c = cost(g, seconds);
+    bool front = false;
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _evaluations++;
+      if (_cache.find(key) != nullptr) _duplicates++;
+      if (cache) _cache.insert(key, fitness, seconds);
+      front = (_cost_weight != 0) && dominated(hash, fitness, c) == false;
+    }
+
+    // graph is serialized outside of lock
+    if (front)
+    {
+      Pareto e{fitness, c, hash, g.save_sparse()};
+      std::lock_guard<std::mutex> lock(_lock);
+      pareto(e);
+    }
+    return fitness - _cost_weight * c;
+  }
+
+  // graph is on pareto front or dominated by a graph on it
+  bool dominated(uint64_t hash, DTYPE fitness, DTYPE cost)
+  {
+    if (std::isnan(fitness)) return true;
+    for (auto& e: _pareto)
+    {
+      if (e.hash == hash) return true;
+      if (e.fitness >= fitness && e.cost <= cost) return true;
+    }
+    return false;
+  }
+
+  // add graph to pareto front unless dominated (front may have changed
+  // since it was checked), remove graphs it dominates
+  void pareto(Pareto& graph)
+  {
+    auto fitness = graph.fitness;
+    auto cost = graph.cost;
+    if (dominated(graph.hash, fitness, cost)) return;
+
+    _pareto.erase(std::remove_if(_pareto.begin(), _pareto.end(),
+    [&](const Pareto& e) { return fitness >= e.fitness && cost <= e.cost; }),
+    _pareto.end());
+    _pareto.push_back(std::move(graph));
+    std::sort(_pareto.begin(), _pareto.end(),
+    [](const Pareto& x, const Pareto& y) { return x.cost < y.cost; });
+
+    // drop graph with least fitness gain over the cheaper graph
+    if (_pareto.size() > PARETO_SIZE)
+    {
+      auto drop = 1;
+      for (auto i=2; i<_pareto.size(); i++)
+      {
+        auto gain = _pareto[i].fitness - _pareto[i-1].fitness;
+        if (gain < _pareto[drop].fitness - _pareto[drop-1].fitness) drop = i;
+      }
+      _pareto.erase(_pareto.begin() + drop);
+    }
+  }
   
 protected:
   RNG _rng;
   uint32_t _epoch;
+  uint32_t _batch; // training samples per episode
+  ThreadPool* _pool;
+  std::vector<Context*> _contexts;
+  int _threads; // threads running population tasks
+  bool _steady; // steady state evolution
+  DTYPE _racing; // racing confidence z (0 is no racing)
+  std::atomic<uint64_t> _races; // aborted episodes
+  DTYPE _threshold; // racing threshold of current evaluation (NaN is none)
+  DTYPE _survivor; // worst survivor fitness without cost of last generation
+  std::vector<uint32_t> _fidelity; // batch size of each evaluation rung
+  std::vector<DTYPE> _promotion; // fraction promoted from each rung
+  bool _common; // common training batch per generation
+  std::chrono::steady_clock::time_point _start; // current run start
+  double _budget; // seconds of current run (0 is no limit)
+  const std::atomic<bool>* _cancel; // current run cancellation token
+  std::mutex _lock; // guards cache, counters and pareto front
   DTYPE _objective;
+  Optimizer* _optimizer;
+  Selection* _selection; // parent selection of generational evolution
+  uint32_t _memo; // evaluations of a duplicate before reuse (0 is never)
+  bool _sparse; // crossover of sparse genomes
+  Mutation _mutation; // mutation probability of genome fields
+  int _crossover; // dense crossover operator
+  Growth _growth; // search space growth policy
+  double _latency; // seconds per graph evaluation in last generation
+  uint64_t _generation; // generations since creation
+  uint32_t _stats_period; // generations between statistics
+  StatisticsSink _stats_sink;
+  int _cost_type; // graph cost measure
+  DTYPE _cost_weight; // fitness penalty per unit of cost
+  std::vector<Pareto> _pareto; // fitness and cost front
+  uint64_t _evaluations;
+  uint64_t _duplicates;
+  FitnessCache _cache;
   std::vector<std::pair<DTYPE, Graph*>> _population;
+  std::vector<Graph*> _spare; // recycled offspring graphs
 };
 
 #endif /*_EAGLE_H_*/
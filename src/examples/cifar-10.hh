@@ -25,92 +25,64 @@ public:
               << " test_images=" << _data.test_images.size()
               << " test_labels=" << _data.test_labels.size()
               << std::endl;
-
-    _training.resize(_data.training_images.size());
-    for (int i=_data.training_images.size()-1; i>=0; i--) _training[i] = i;
   } 
 
 protected:
   // mnist data
   cifar::CIFAR10_dataset<std::vector, std::vector<uint8_t>, uint8_t> _data;
 
-  // data index
-  std::vector<int> _training;
-
   // set input
   void set_input(Graph& g, std::vector<uint8_t>& image)
   {
-    for (int rgb=0; rgb<3; rgb++)
-    for (int r=0; r<32; r++)
-    for (int c=0; c<32; c++)
-    {
-      g.set(rgb * 32 * 32 + r * 32 + c, image[rgb * 32 * 32 + r * 32 + c]);
-    }
+    // normalize pixels to [0,1]
+    g.set_inputs(image.data(), image.size(), 1.f / 255);
   }
 
   // get output
   int get_output(Graph& g)
   {
-    int size = g._meta.output;
-    std::vector<DTYPE> output(size);
-    for (int i=0; i<size; i++) output[i] = g.get(i);
-    return _rng.discrete_choice(output.begin(), output.end());
+    DTYPE output[10];
+    g.outputs(output, 10);
+    return g._rng->categorical(output, output + 10);
   }
 
-  // train episode that updates graph weights and returns graph reward
-  virtual DTYPE episode(Graph& g)
+  // number of samples in data split
+  virtual uint32_t samples(int split)
   {
-    // set batch size
-    int batch = 1000;
-
-    // randomize training samples
-    _rng.shuffle(_training.begin(), _training.end());
-
-    // train on batch
-    DTYPE R = 0;
-    for (int i=0; i<batch; i++)
-    {
-      int ir = _training[i];
-      auto& image = _data.training_images[ir];
-      auto label = _data.training_labels[ir];
+    if (split == SPLIT_TRAIN) return _data.training_images.size();
+    if (split == SPLIT_TEST) return _data.test_images.size();
+    return 0;
+  }
 
-      g.reset();
-      set_input(g, image);
-      DTYPE y = get_output(g);
-      DTYPE y_hat = label;
-      DTYPE r = (y == y_hat) ? 1 : 0;
-      g.reward(r);
-      g.gradient();
-      R += r;
-    }
-    g.update();
+  // run graph on sample from data split and return its reward
+  virtual DTYPE sample(Graph& g, int split, uint32_t index)
+  {
+    bool train = (split == SPLIT_TRAIN);
+    auto& image = train ? _data.training_images[index] : _data.test_images[index];
 
-    // calculate fitness
-    return R / batch;
+    g.reset();
+    set_input(g, image);
+    return output(g, split, index);
   }
 
-  DTYPE validate(Graph& g)
+  // normalize pixels of sample once for all graphs evaluated on it
+  virtual bool input(int split, uint32_t index, float* data)
   {
-    // set batch size
-    int batch = _data.test_images.size();
-
-    // validate on test
-    DTYPE R = 0;
-    for (int i=0; i<batch; i++)
-    {
-      auto& image = _data.test_images[i];
-      auto label = _data.test_labels[i];
+    bool train = (split == SPLIT_TRAIN);
+    auto& image = train ? _data.training_images[index] : _data.test_images[index];
+    for (auto i=0; i<image.size(); i++) data[i] = image[i] * (1.f / 255);
+    return true;
+  }
 
-      g.reset();
-      set_input(g, image);
-      DTYPE y = get_output(g);
-      DTYPE y_hat = label;
-      DTYPE r = (y == y_hat) ? 1 : 0;
-      R += r;
-    }
+  // reward of graph with sample inputs set
+  virtual DTYPE output(Graph& g, int split, uint32_t index)
+  {
+    bool train = (split == SPLIT_TRAIN);
+    auto label = train ? _data.training_labels[index] : _data.test_labels[index];
 
-    // calculate fitness
-    return R / batch;
+    DTYPE y = get_output(g);
+    DTYPE y_hat = label;
+    return (y == y_hat) ? 1 : 0;
   }
 };
 
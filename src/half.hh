@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2019 Greg Padiasek
+ * Distributed under the terms of the the 3-Clause BSD License.
+ * See the accompanying file LICENSE or the copy at
+ * https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+#ifndef _HALF_PRECISION_H_
+#define _HALF_PRECISION_H_
+
+// IEEE 754 binary16 storage type, arithmetic is done in float
+class half
+{
+public:
+  half() : _bits(0) {}
+  half(float f) : _bits(encode(f)) {}
+  operator float() const { return decode(_bits); }
+  half& operator+=(float f) { _bits = encode(decode(_bits) + f); return *this; }
+
+  static uint16_t encode(float f)
+  {
+#ifdef __F16C__
+    return _cvtss_sh(f, 0);
+#else
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t abs = x & 0x7FFFFFFF;
+
+    // nan and inf
+    if (abs >= 0x7F800000) return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+    // overflow to inf
+    if (abs >= 0x477FF000) return sign | 0x7C00;
+    // subnormal or zero, round to nearest even
+    if (abs < 0x38800000)
+    {
+      if (abs < 0x33000000) return sign;
+      uint32_t shift = 126 - (abs >> 23);
+      uint32_t mant = (abs & 0x7FFFFF) | 0x800000;
+      uint32_t bits = mant >> shift;
+      uint32_t rest = mant & ((1u << shift) - 1);
+      uint32_t halfway = 1u << (shift - 1);
+      if (rest > halfway || (rest == halfway && (bits & 1))) bits++;
+      return sign | bits;
+    }
+    // normal, rebias exponent and round to nearest even
+    uint32_t bits = (abs - 0x38000000) >> 13;
+    uint32_t rest = abs & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (bits & 1))) bits++;
+    return sign | bits;
+#endif
+  }
+
+  static float decode(uint16_t h)
+  {
+#ifdef __F16C__
+    return _cvtsh_ss(h);
+#else
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t x;
+    if (exp == 0x1F) x = sign | 0x7F800000 | (mant << 13);
+    else if (exp != 0) x = sign | ((exp + 112) << 23) | (mant << 13);
+    else if (mant == 0) x = sign;
+    else
+    {
+      // normalize subnormal
+      exp = 113;
+      while ((mant & 0x400) == 0) { mant <<= 1; exp--; }
+      x = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+#endif
+  }
+
+private:
+  uint16_t _bits;
+};
+
+// brain floating point storage type (float with 8-bit mantissa),
+// keeps float range so large states do not overflow
+class bfloat
+{
+public:
+  bfloat() : _bits(0) {}
+  bfloat(float f) : _bits(encode(f)) {}
+  operator float() const { return decode(_bits); }
+  bfloat& operator+=(float f) { _bits = encode(decode(_bits) + f); return *this; }
+
+  static uint16_t encode(float f)
+  {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    // keep nan quiet
+    if ((x & 0x7FFFFFFF) > 0x7F800000) return (x >> 16) | 0x40;
+    // round to nearest even
+    x += 0x7FFF + ((x >> 16) & 1);
+    return x >> 16;
+  }
+
+  static float decode(uint16_t b)
+  {
+    uint32_t x = (uint32_t)b << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+
+private:
+  uint16_t _bits;
+};
+
+#endif /*_HALF_PRECISION_H_*/
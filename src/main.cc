@@ -22,6 +22,10 @@ extern void master_term();
 // worker routines
 extern void worker_run(const std::string& library,
 const std::string& host, int port);
+extern void worker_train(const std::string& library,
+const std::string& file, int epochs);
+extern void worker_validate(const std::string& library,
+const std::string& file);
 extern void worker_term();
 
 // term routine
@@ -45,7 +49,9 @@ static void on_signal(int signum) {
 void syntax(char* argv[]) {
   std::cerr << "Usage: " << argv[0] << " "
             << "master <FILE> <PORT> | "
-            << "worker <HOST> <PORT> <IMPL>"
+            << "worker <HOST> <PORT> <IMPL> | "
+            << "train <FILE> <IMPL> <EPOCHS> | "
+            << "validate <FILE> <IMPL>"
             << std::endl;
 }
 
@@ -104,6 +110,40 @@ int main(int argc, char* argv[]) {
       std::cout << "Stopping " << role << " at " 
                 << host << ":" << port << std::endl;
     }
+    else
+    if (role == "train") {
+      if (argc != 5) {
+        syntax(argv);
+        return 1;
+      }
+
+      std::string file = argv[2];
+      std::string impl = argv[3];
+      int epochs = std::stoi(argv[4]);
+      std::cout << "Starting " << role << " of " << file << std::endl;
+
+      // start training
+      term_routine = worker_term;
+      worker_train(impl, file, epochs);
+
+      std::cout << "Stopping " << role << " of " << file << std::endl;
+    }
+    else
+    if (role == "validate") {
+      if (argc != 4) {
+        syntax(argv);
+        return 1;
+      }
+
+      std::string file = argv[2];
+      std::string impl = argv[3];
+      std::cout << "Starting " << role << " of " << file << std::endl;
+
+      // start validation
+      worker_validate(impl, file);
+
+      std::cout << "Stopping " << role << " of " << file << std::endl;
+    }
     else {
       std::cerr << "Unknown role '" << role << "'" << std::endl;
       return 3;
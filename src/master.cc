@@ -48,6 +48,31 @@ void save_graph(const std::string& graph, float fitness, const std::string& file
   dl::write_file(data, file);
 }
 
+void load_graph(std::string& graph, float& fitness, const std::string& file)
+{
+  std::stringstream data;
+  dl::read_file(file, data);
+
+  short version = 0;
+  data.read((char*)&version, sizeof(version));
+
+  if (version != 1)
+  {
+    std::ostringstream error;
+    error << "Unsupported file version " << version;
+    throw std::runtime_error(error.str());
+  }
+
+  fitness = NAN;
+  data.read((char*)&fitness, sizeof(fitness));
+
+  int graph_size = 0;
+  data.read((char*)&graph_size, sizeof(graph_size));
+
+  graph.assign(graph_size, 0);
+  data.read((char*)graph.data(), graph_size);
+}
+
 void on_get_fitness(
 const eagle::GetFitness& req, eagle::Response& res)
 {
@@ -89,27 +114,9 @@ void master_init(const std::string& file)
 
   try
   {
-    std::stringstream data;
-    dl::read_file(master_file, data);
-
-    short version = 0;
-    data.read((char*)&version, sizeof(version));
-
-    if (version != 1)
-    {
-      std::ostringstream error;
-      error << "Unsupported file version " << version;
-      throw std::runtime_error(error.str());
-    }
-
     float graph_fitness = NAN;
-    data.read((char*)&graph_fitness, sizeof(graph_fitness));
-
-    int graph_size = 0;
-    data.read((char*)&graph_size, sizeof(graph_size));
-
-    std::string graph_data(graph_size, 0);
-    data.read((char*)graph_data.data(), graph_size);
+    std::string graph_data;
+    load_graph(graph_data, graph_fitness, master_file);
 
     std::lock_guard<std::mutex> lock(master_lock);
     master_fitness = graph_fitness;
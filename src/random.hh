@@ -6,6 +6,7 @@
  */
 
 #include <random>
+#include <vector>
 
 #ifndef _RANDOM_NUMBER_GENERATOR_H_
 #define _RANDOM_NUMBER_GENERATOR_H_
@@ -47,6 +48,25 @@ public:
     return d(generator);
   }
   
+  // 32 random bits
+  uint32_t uniform_bits()
+  {
+    return generator();
+  }
+
+  int poisson_int(float mean)
+  {
+    std::poisson_distribution<int> d(mean);
+    return d(generator);
+  }
+
+  // number of failed trials before the first success of probability p
+  uint64_t geometric_int(float p)
+  {
+    std::geometric_distribution<uint64_t> d(p);
+    return d(generator);
+  }
+
   float normal_dec(float mean, float stddev)
   {
      std::normal_distribution<float> d(mean, stddev);
@@ -60,6 +80,49 @@ public:
     return d(generator);
   }
 
+  // allocation-free choice of index with probability proportional to weight,
+  // uniform when all weights are zero
+  template<class Iterator>
+  int categorical(Iterator first, Iterator last)
+  {
+    int size = last - first;
+    if (size <= 0) return 0;
+
+    // all-binary weights reduce to uniform choice among ones
+    int ones = 0;
+    bool binary = true;
+    double total = 0;
+    for (auto it = first; it != last; ++it)
+    {
+      total += *it;
+      ones += (*it == 1);
+      binary = binary && (*it == 0 || *it == 1);
+    }
+    if (total <= 0) return uniform_int(size - 1);
+
+    if (binary)
+    {
+      auto k = uniform_int(ones - 1);
+      for (int i=0; i<size; i++, ++first)
+      {
+        if (*first == 1 && k-- == 0) return i;
+      }
+    }
+    else
+    {
+      std::uniform_real_distribution<double> d(0.0, total);
+      auto u = d(generator);
+      for (int i=0; i<size; i++, ++first)
+      {
+        if (*first > 0 && (u -= *first) < 0) return i;
+      }
+    }
+
+    // rounding error, pick last non-zero weight
+    while (size > 0 && *(--last) <= 0) size--;
+    return size - 1;
+  }
+
   template<class Iterator>
   void shuffle(Iterator first, Iterator last)
   {
@@ -71,4 +134,66 @@ private:
   std::mt19937 generator;
 };
 
+// walker alias table, draws index with probability proportional to weight
+// in constant time after linear time build
+class AliasTable
+{
+public:
+  // uniform when all weights are zero
+  template<class Iterator>
+  void build(Iterator first, Iterator last)
+  {
+    uint32_t size = last - first;
+    double total = 0;
+    for (auto it = first; it != last; ++it) total += *it;
+    _prob.assign(size, 1);
+    _alias.resize(size);
+    for (uint32_t i=0; i<size; i++) _alias[i] = i;
+    if (total <= 0) return;
+
+    // split scaled weights into under and over full columns
+    std::vector<double> scaled(size);
+    std::vector<uint32_t> small, large;
+    for (uint32_t i=0; i<size; i++, ++first)
+    {
+      scaled[i] = *first * size / total;
+      if (scaled[i] < 1) small.push_back(i);
+      else large.push_back(i);
+    }
+
+    // fill each under full column with the rest of an over full one
+    while (small.size() && large.size())
+    {
+      auto s = small.back();
+      auto l = large.back();
+      small.pop_back();
+      _prob[s] = scaled[s];
+      _alias[s] = l;
+      scaled[l] -= 1 - scaled[s];
+      if (scaled[l] < 1)
+      {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+
+    // rounding error, remaining columns are full
+    for (auto e: small) _prob[e] = 1;
+    for (auto e: large) _prob[e] = 1;
+  }
+
+  uint32_t sample(RNG& rng) const
+  {
+    if (_prob.empty()) return 0;
+    uint32_t i = rng.uniform_int(_prob.size() - 1);
+    return (rng.uniform_dec(1) < _prob[i]) ? i : _alias[i];
+  }
+
+  uint32_t size() const { return _prob.size(); }
+
+private:
+  std::vector<float> _prob;
+  std::vector<uint32_t> _alias;
+};
+
 #endif /*_RANDOM_NUMBER_GENERATOR_H_*/
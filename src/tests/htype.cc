@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2019 Greg Padiasek
+ * Distributed under the terms of the the 3-Clause BSD License.
+ * See the accompanying file LICENSE or the copy at
+ * https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include "eagle.hh"
+
+// run one sample with reward depending on its first input
+void sample(Graph& g, const uint8_t* input)
+{
+  g.reset();
+  g.set_inputs(input, 8, 1.f / 255);
+  DTYPE output[2];
+  g.outputs(output, 2);
+  g.reward(0.37f * (input[0] & 1));
+}
+
+// gradients of many samples summed under HTYPE history storage must
+// match the sum of per-sample gradients
+int check(RNG& rng)
+{
+  int errors = 0;
+  for (auto k=0; k<10; k++)
+  {
+    Graph a(8, 2, 4, 2, rng), b(8, 2, 4, 2, rng), g(0, 0, 0, 0, rng);
+    if (g.recombine(a.save(), b.save(), Graph::default_optimizer(),
+                    Mutation(0.3), CROSSOVER_UNIFORM) == false) continue;
+
+    auto nodes_size = g._nodes.size();
+    std::vector<std::vector<DTYPE>> sums(nodes_size), wgrads(nodes_size);
+    for (auto i=0; i<nodes_size; i++) sums[i].assign(g._nodes[i]->_wgrad.size(), 0);
+
+    for (auto s=0; s<1000; s++)
+    {
+      uint8_t input[8];
+      for (auto j=0; j<8; j++) input[j] = rng.uniform_int(255);
+      sample(g, input);
+
+      // accumulated gradients
+      g.gradient();
+      for (auto i=0; i<nodes_size; i++)
+      {
+        auto& wgrad = g._nodes[i]->_wgrad;
+        wgrads[i].assign(wgrad.begin(), wgrad.end());
+        wgrad.assign(wgrad.size(), 0);
+      }
+
+      // gradients of this sample alone summed in DTYPE
+      g.gradient();
+      for (auto i=0; i<nodes_size; i++)
+      {
+        auto& wgrad = g._nodes[i]->_wgrad;
+        for (auto j=0; j<wgrad.size(); j++)
+        {
+          sums[i][j] += wgrad[j];
+          wgrad[j] = wgrads[i][j];
+        }
+      }
+    }
+
+    for (auto i=0; i<nodes_size; i++)
+    {
+      auto& wgrad = g._nodes[i]->_wgrad;
+      for (auto j=0; j<wgrad.size(); j++)
+      {
+        if (fabs(wgrad[j] - sums[i][j]) > 1e-3 * (1 + fabs(sums[i][j])))
+        {
+          std::cout << "gradient sum " << wgrad[j] << " expected "
+                    << sums[i][j] << std::endl;
+          errors++;
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+int main()
+{
+  RNG rng;
+  int errors = check(rng);
+  std::cout << (errors ? "FAILED" : "OK") << std::endl;
+  return errors ? 1 : 0;
+}
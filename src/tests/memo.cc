@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2019 Greg Padiasek
+ * Distributed under the terms of the the 3-Clause BSD License.
+ * See the accompanying file LICENSE or the copy at
+ * https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include "eagle.hh"
+
+// parity of the first input with fitness reused after one evaluation
+class Parity : public NeuroEvolution
+{
+public:
+  Parity() : NeuroEvolution(8, 2, 4, 2, 2)
+  {
+    _memo = 1;
+  }
+
+  using NeuroEvolution::evaluate;
+
+protected:
+  uint32_t samples(int split) { return 1000; }
+
+  DTYPE sample(Graph& g, int split, uint32_t index)
+  {
+    uint8_t input[8];
+    for (auto j=0; j<8; j++) input[j] = g._rng->uniform_int(255);
+    g.reset();
+    g.set_inputs(input, 8, 1.f / 255);
+    DTYPE output[2];
+    g.outputs(output, 2);
+    return (g._rng->categorical(output, output + 2) == (input[0] & 1)) ? 1 : -1;
+  }
+};
+
+// weights and biases of all nodes
+std::vector<DTYPE> parameters(const Graph& g)
+{
+  std::vector<DTYPE> p;
+  for (auto node_p: g._nodes)
+  {
+    p.push_back(node_p->get_bias());
+    p.insert(p.end(), node_p->_weight.begin(), node_p->_weight.end());
+  }
+  return p;
+}
+
+// duplicate of an evaluated graph gets the cached fitness but still trains
+int check(Parity& ne, RNG& rng)
+{
+  int errors = 0;
+  for (auto k=0; k<20; k++)
+  {
+    Graph a(8, 2, 4, 2, rng), b(8, 2, 4, 2, rng), g(0, 0, 0, 0, rng);
+    if (g.recombine(a.save(), b.save(), Graph::default_optimizer(),
+                    Mutation(0.3), CROSSOVER_UNIFORM) == false) continue;
+
+    // small parameters so that nodes do not saturate
+    for (auto node_p: g._nodes)
+    {
+      node_p->set_bias(0);
+      for (auto& w: node_p->_weight) w = rng.uniform_dec(-1, 1);
+    }
+    g._synced = false;
+    std::string dna = g.save();
+    Graph duplicate(0, 0, 0, 0, rng);
+    g.load(dna);
+    duplicate.load(dna);
+    auto weights = parameters(duplicate);
+
+    auto duplicates = ne.duplicates();
+    auto fitness = ne.evaluate(g, 1000);
+    if (ne.evaluate(duplicate, 1000) != fitness || ne.duplicates() == duplicates)
+    {
+      std::cout << "duplicate not memoized" << std::endl;
+      errors++;
+    }
+
+    // otherwise a memoized survivor would keep its weights in all
+    // following generations
+    if (parameters(duplicate) == weights)
+    {
+      std::cout << "memoized graph not trained" << std::endl;
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int main()
+{
+  RNG rng;
+  Parity ne;
+  int errors = check(ne, rng);
+  std::cout << (errors ? "FAILED" : "OK") << std::endl;
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2019 Greg Padiasek
+ * Distributed under the terms of the the 3-Clause BSD License.
+ * See the accompanying file LICENSE or the copy at
+ * https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include "eagle.hh"
+
+// train graph on random inputs and apply gradients with its optimizer
+void train(Graph& g, RNG& rng, int samples)
+{
+  for (auto i=0; i<samples; i++)
+  {
+    uint8_t input[8];
+    for (auto j=0; j<8; j++) input[j] = rng.uniform_int(255);
+    g.reset();
+    g.set_inputs(input, 8, 1.f / 255);
+    DTYPE output[2];
+    g.outputs(output, 2);
+    g.reward(rng.categorical(output, output + 2) == (input[0] & 1));
+    g.gradient();
+  }
+  g.update();
+}
+
+// patched save after updates must keep the header and match a full save
+int check(const Optimizer& opt, RNG& rng)
+{
+  int errors = 0;
+  for (auto k=0; k<50; k++)
+  {
+    Graph a(8, 2, 4, 2, rng), b(8, 2, 4, 2, rng), g(0, 0, 0, 0, rng);
+    if (g.recombine(a.save(), b.save(), opt, Mutation(0.3), CROSSOVER_UNIFORM) == false) continue;
+
+    g.save();
+    for (auto i=0; i<3; i++) train(g, rng, 20);
+    std::string patched = g.save();
+
+    if (memcmp(patched.data(), &g._meta, sizeof(Graph::MetaData)))
+    {
+      std::cout << "header overwritten" << std::endl;
+      errors++;
+    }
+
+    g._synced = false;
+    if (patched != g.save())
+    {
+      std::cout << "node genes differ from full save" << std::endl;
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int main()
+{
+  RNG rng;
+  Momentum momentum;
+  Adam adam;
+  int errors = check(momentum, rng) + check(adam, rng);
+  std::cout << (errors ? "FAILED" : "OK") << std::endl;
+  return errors ? 1 : 0;
+}
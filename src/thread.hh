@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2019 Greg Padiasek
+ * Distributed under the terms of the the 3-Clause BSD License.
+ * See the accompanying file LICENSE or the copy at
+ * https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <utility>
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+// fixed size pool running batches of indexed tasks, the calling thread
+// takes part in each batch as thread 0
+class ThreadPool
+{
+public:
+  typedef std::function<void(uint32_t task, int thread)> Task;
+
+  ThreadPool(int threads)
+  {
+    _stop = false;
+    _batch = 0;
+    _busy = 0;
+    _task = nullptr;
+    _count = 0;
+    _next = 0;
+    for (int i=1; i<threads; i++) _threads.emplace_back(&ThreadPool::loop, this, i);
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& e: _threads) e.join();
+  }
+
+  // number of threads including the caller
+  int size() const { return _threads.size() + 1; }
+
+  // run task(i, thread) for i in [0, count) and wait for completion
+  void run(uint32_t count, const Task& task)
+  {
+    if (_threads.empty())
+    {
+      for (uint32_t i=0; i<count; i++) task(i, 0);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _task = &task;
+      _count = count;
+      _next = 0;
+      _busy = _threads.size();
+      _batch++;
+    }
+    _wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(_lock);
+    _done.wait(lock, [this]{ return _busy == 0; });
+    _task = nullptr;
+  }
+
+private:
+  // take tasks until the batch is exhausted
+  void work(int thread)
+  {
+    for (;;)
+    {
+      uint32_t i = _next++;
+      if (i >= _count) break;
+      (*_task)(i, thread);
+    }
+  }
+
+  void loop(int thread)
+  {
+    uint64_t batch = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(_lock);
+        _wake.wait(lock, [&]{ return _stop || _batch != batch; });
+        if (_stop) return;
+        batch = _batch;
+      }
+
+      work(thread);
+
+      std::lock_guard<std::mutex> lock(_lock);
+      if (--_busy == 0) _done.notify_one();
+    }
+  }
+
+  std::vector<std::thread> _threads;
+  std::mutex _lock;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  const Task* _task;
+  uint32_t _count;
+  std::atomic<uint32_t> _next;
+  uint64_t _batch;
+  int _busy;
+  bool _stop;
+};
+
+// lock-free bounded multi-producer multi-consumer queue, cells carry a
+// sequence number that tells producers and consumers whose turn it is
+template<class T>
+class BoundedQueue
+{
+public:
+  // capacity is rounded up to a power of 2
+  BoundedQueue(uint32_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    _mask = size - 1;
+    _cells = new Cell[size];
+    for (size_t i=0; i<size; i++) _cells[i].sequence.store(i, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+  }
+
+  ~BoundedQueue()
+  {
+    delete[] _cells;
+  }
+
+  // add value, false if the queue is full
+  bool push(T value)
+  {
+    Cell* cell;
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &_cells[pos & _mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0)
+      {
+        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0) return false;
+      else pos = _tail.load(std::memory_order_relaxed);
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // take oldest value, false if the queue is empty
+  bool pop(T& value)
+  {
+    Cell* cell;
+    size_t pos = _head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &_cells[pos & _mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0)
+      {
+        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0) return false;
+      else pos = _head.load(std::memory_order_relaxed);
+    }
+    value = std::move(cell->value);
+    cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  Cell* _cells;
+  size_t _mask;
+  char _pad0[64]; // head and tail on separate cache lines
+  std::atomic<size_t> _head;
+  char _pad1[64];
+  std::atomic<size_t> _tail;
+};
+
+#endif /*_THREAD_POOL_H_*/
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2019 Greg Padiasek
+ * Distributed under the terms of the the 3-Clause BSD License.
+ * See the accompanying file LICENSE or the copy at
+ * https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#include <functional>
+
+#include "eagle.hh"
+
+#ifndef _AUTO_TUNER_H_
+#define _AUTO_TUNER_H_
+
+// parameters adjusted by the tuner (threads are not tuned, islands of
+// a worker already use all cores)
+#define TUNE_POPULATION 0
+#define TUNE_EPOCH      1
+#define TUNE_BATCH      2
+#define TUNE_KNOBS      3
+
+// runs measured per tuner decision
+#define TUNER_WINDOW 5
+
+// factor of a parameter change
+#define TUNER_STEP 2.0
+
+// tuner decision on a parameter
+struct Decision
+{
+  const char* knob;    // parameter name
+  const char* action;  // try, keep or revert
+  uint32_t from;       // value before decision
+  uint32_t to;         // value after decision
+  double rate;         // evaluations per second of last window
+  double gain;         // fitness gain per cpu-second of last window
+};
+
+typedef std::function<void(const Decision&)> DecisionSink;
+
+// online hill climbing of throughput parameters, each window of runs
+// measures fitness gain per cpu-second (evaluations per second break
+// ties), a changed parameter is kept if the window after the change
+// scores better than the window before and reverted otherwise
+class Tuner
+{
+public:
+  Tuner(const DecisionSink& sink, uint32_t window = TUNER_WINDOW)
+  {
+    _sink = sink;
+    _window = std::max(window, 1u);
+    _runs = 0;
+    _seconds = 0;
+    _cpu = 0;
+    _evaluations = 0;
+    _fitness = NAN;
+    _started = false;
+    _trial = false;
+    _knob = 0;
+    _previous = 0;
+    _base = Score{0, 0};
+    for (auto i=0; i<TUNE_KNOBS; i++)
+    {
+      _min[i] = 1;
+      _max[i] = UINT_MAX;
+      _direction[i] = 1;
+    }
+  }
+
+  // limit parameter to [min, max], min == max fixes it
+  void set_bounds(int knob, uint32_t min, uint32_t max)
+  {
+    _min[knob] = std::max(min, 1u);
+    _max[knob] = std::max(max, _min[knob]);
+  }
+
+  // move parameters of impl into their bounds
+  void clamp(NeuroEvolution& impl)
+  {
+    for (auto i=0; i<TUNE_KNOBS; i++)
+    {
+      set(impl, i, std::max(_min[i], std::min(_max[i], get(impl, i))));
+    }
+  }
+
+  // account run of impl that took seconds, adjust one parameter at the end
+  // of each window
+  void update(NeuroEvolution& impl, double seconds)
+  {
+    // window starts after the first run
+    if (_started == false)
+    {
+      restart(impl);
+      _started = true;
+      return;
+    }
+
+    _runs++;
+    _seconds += seconds;
+    _cpu += seconds * impl.threads();
+    if (_runs < _window) return;
+
+    Score score;
+    auto fitness = impl.fitness();
+    score.rate = (impl.evaluations() - _evaluations) / std::max(_seconds, 1e-9);
+    score.gain = (fitness - _fitness) / std::max(_cpu, 1e-9);
+    if (std::isnan(score.gain)) score.gain = 0;
+    restart(impl);
+
+    if (_trial)
+    {
+      _trial = false;
+      auto value = get(impl, _knob);
+      if (better(score, _base))
+      {
+        // same parameter and direction again
+        log("keep", value, value, score);
+        _base = score;
+      }
+      else
+      {
+        // measure baseline before next change
+        set(impl, _knob, _previous);
+        log("revert", value, _previous, score);
+        _direction[_knob] = -_direction[_knob];
+        _knob = (_knob + 1) % TUNE_KNOBS;
+        return;
+      }
+    }
+    else _base = score;
+
+    propose(impl, score);
+  }
+
+private:
+  struct Score
+  {
+    double rate; // evaluations per second
+    double gain; // fitness gain per cpu-second
+  };
+
+  void restart(NeuroEvolution& impl)
+  {
+    _runs = 0;
+    _seconds = 0;
+    _cpu = 0;
+    _evaluations = impl.evaluations();
+    _fitness = impl.fitness();
+  }
+
+  static bool better(const Score& a, const Score& b)
+  {
+    if (a.gain != b.gain) return a.gain > b.gain;
+    return a.rate > b.rate;
+  }
+
+  // change next parameter that can move, reversing direction at bounds
+  void propose(NeuroEvolution& impl, const Score& score)
+  {
+    for (auto i=0; i<2 * TUNE_KNOBS; i++)
+    {
+      auto value = get(impl, _knob);
+      auto next = (_direction[_knob] > 0) ? value * TUNER_STEP
+                                          : value / TUNER_STEP;
+      auto to = (uint32_t) std::max<double>(_min[_knob],
+                           std::min<double>(_max[_knob], next));
+      set(impl, _knob, to);
+      to = get(impl, _knob);
+      if (to != value)
+      {
+        _previous = value;
+        _trial = true;
+        log("try", value, to, score);
+        return;
+      }
+
+      // at bound, other direction next time
+      _direction[_knob] = -_direction[_knob];
+      if (i % 2) _knob = (_knob + 1) % TUNE_KNOBS;
+    }
+  }
+
+  uint32_t get(NeuroEvolution& impl, int knob)
+  {
+    switch (knob)
+    {
+      case TUNE_POPULATION: return impl.size();
+      case TUNE_EPOCH: return impl.epoch();
+      default: return impl.batch();
+    }
+  }
+
+  void set(NeuroEvolution& impl, int knob, uint32_t value)
+  {
+    switch (knob)
+    {
+      case TUNE_POPULATION: impl.set_size(value); break;
+      case TUNE_EPOCH: impl.set_epoch(value); break;
+      default: impl.set_batch(value); break;
+    }
+  }
+
+  void log(const char* action, uint32_t from, uint32_t to, const Score& score)
+  {
+    static const char* names[TUNE_KNOBS] = {"population", "epoch", "batch"};
+    if (_sink) _sink(Decision{names[_knob], action, from, to, score.rate, score.gain});
+  }
+
+  DecisionSink _sink;
+  uint32_t _window;
+  uint32_t _runs;       // runs in current window
+  double _seconds;      // wall time of current window
+  double _cpu;          // cpu time of current window
+  uint64_t _evaluations; // evaluations at window start
+  DTYPE _fitness;       // best fitness at window start
+  bool _started;
+  bool _trial;          // window measures a changed parameter
+  int _knob;            // parameter changed or changed next
+  uint32_t _previous;   // parameter value before change
+  Score _base;          // score before change
+  uint32_t _min[TUNE_KNOBS];
+  uint32_t _max[TUNE_KNOBS];
+  int _direction[TUNE_KNOBS];
+};
+
+#endif /*_AUTO_TUNER_H_*/
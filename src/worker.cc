@@ -8,25 +8,75 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <mutex>
 
 #include <dlfcn.h>
 
 #include "transport.hh"
 #include "eagle.pb.h"
 #include "eagle.hh"
+#include "tuner.hh"
+
+// island migration topologies
+#define TOPOLOGY_RING   0
+#define TOPOLOGY_RANDOM 1
+#define TOPOLOGY_FULL   2
+
+// migrants waiting in island inbox
+#define MIGRATION_QUEUE 16
 
 // worker runtime data
 
-bool done = false;
+std::atomic<bool> done(false);
 std::string host;
 int port = -1;
 
+// runs between champion test set checks on the first thread (0 is never)
+int validate_period = 100;
+
+// generations between population statistics (0 is never)
+int statistics_period = 1000;
+
+// seconds of evolution between master syncs (0 is whole epoch), not
+// used while the tuner adjusts the epoch
+double run_budget = 10;
+
+// runs per auto-tuner decision (0 is never) and bounds of tuned population,
+// epoch and batch
+int tuner_window = TUNER_WINDOW;
+uint32_t tuner_bounds[TUNE_KNOBS][2] = {{16, 256}, {1, 100}, {100, 10000}};
+
+// island migration topology and runs between migrations (0 is never)
+int migration_topology = TOPOLOGY_RING;
+int migration_period = 1;
+
+// graph sent between islands
+struct Migrant
+{
+  float fitness;
+  std::string graph;
+};
+
+// island inboxes, one per thread
+std::vector<BoundedQueue<Migrant>*> islands;
+
+// process champion, the only graph exchanged with master
+std::mutex champion_lock;
+Migrant champion = {NAN, ""};
+
 typedef NeuroEvolution* (*create_callback)();
 typedef void (*destroy_callback)(NeuroEvolution*);
 
 create_callback create = nullptr;
 destroy_callback destroy = nullptr;
 
+// graph file routines
+extern void save_graph(const std::string& graph, float fitness,
+const std::string& file);
+extern void load_graph(std::string& graph, float& fitness,
+const std::string& file);
+
 // command handlers
 
 DTYPE get_fitness()
@@ -98,47 +148,189 @@ void set_graph(const std::string& graph, DTYPE fitness, DTYPE master_fitness)
 
 // worker routines
 
-void thread_run()
+void log_validation(const Validation& v)
+{
+  std::cout << "thread " << std::this_thread::get_id()
+            << ", test accuracy " << v.accuracy
+            << ", samples " << v.samples
+            << ", time " << v.seconds << "s" << std::endl;
+}
+
+void log_statistics(const Statistics& s)
+{
+  std::ostringstream fanins, types;
+  for (auto i=0; i<FANIN_BUCKETS; i++) fanins << (i ? "/" : "") << s.fanins[i];
+  for (auto i=NODE_MINIMUM+1; i<=NODE_MAXIMUM; i++) types << (i > NODE_MINIMUM+1 ? "/" : "") << s.types[i];
+
+  std::cout << "thread " << std::this_thread::get_id()
+            << ", generation " << s.generation
+            << ", fitness " << s.fitness << " (" << s.best << ")"
+            << ", nodes " << s.nodes
+            << ", links " << s.links
+            << ", depth " << s.depth << " (" << s.max_depth << ")"
+            << ", fan-in " << s.fanin << " (" << s.max_fanin << ") " << fanins.str()
+            << ", types " << types.str()
+            << ", usage " << s.usage
+            << ", duplicates " << s.duplicates
+            << ", geometry " << s.hidden << "x" << s.capacity << std::endl;
+}
+
+void log_decision(const Decision& d)
+{
+  std::cout << "thread " << std::this_thread::get_id()
+            << ", tuner " << d.action << " " << d.knob
+            << " " << d.from << " -> " << d.to
+            << ", evaluations/s " << d.rate
+            << ", gain/cpu-s " << d.gain << std::endl;
+}
+
+// send island best graph to neighbours in migration topology
+void migrate(int index, NeuroEvolution& impl, RNG& rng)
+{
+  int size = islands.size();
+  if (size < 2) return;
+
+  Migrant migrant = {impl.fitness(), impl.best()};
+  switch (migration_topology)
+  {
+    case TOPOLOGY_FULL:
+      for (int i=0; i<size; i++)
+      if (i != index) islands[i]->push(migrant);
+      break;
+    case TOPOLOGY_RANDOM:
+      islands[(index + 1 + rng.uniform_int(size - 2)) % size]->push(migrant);
+      break;
+    default:
+      islands[(index + 1) % size]->push(migrant);
+      break;
+  }
+}
+
+// seed best received migrant into island population
+void immigrate(int index, NeuroEvolution& impl)
+{
+  Migrant best = {NAN, ""}, migrant;
+  while (islands[index]->pop(migrant))
+  {
+    if (std::isnan(best.fitness) || migrant.fitness > best.fitness)
+      best = std::move(migrant);
+  }
+  if (best.graph.size()) impl.seed(best.graph);
+}
+
+// exchange process champion with master, returns false when done
+bool sync_master(NeuroEvolution& impl)
+{
+  Migrant local;
+  {
+    std::lock_guard<std::mutex> lock(champion_lock);
+    local = champion;
+  }
+
+  // master fitness
+  auto master_fitness = get_fitness();
+
+  // stop if desiret accuracy was reached
+  if (master_fitness >= impl.objective()) return false;
+
+  // validate fitness
+  bool master_nan = std::isnan(master_fitness);
+  bool worker_nan = std::isnan(local.fitness);
+
+  // get master graph to local population
+  if (master_fitness > local.fitness || (!master_nan && worker_nan))
+  {
+    impl.seed(get_graph(local.fitness));
+  }
+  else
+  // send process champion to master
+  if (master_fitness < local.fitness || (master_nan && !worker_nan))
+  {
+    set_graph(local.graph, local.fitness, master_fitness);
+  }
+  return true;
+}
+
+void thread_run(int index)
 {
   RNG rng;
   NeuroEvolution& impl = *create();
+  impl.set_statistics(statistics_period, log_statistics);
+  int runs = 0;
+
+  Tuner tuner(log_decision, tuner_window);
+  for (auto i=0; i<TUNE_KNOBS; i++)
+  {
+    tuner.set_bounds(i, tuner_bounds[i][0], tuner_bounds[i][1]);
+  }
+
+  // a tuned epoch sets the length of each run
+  auto budget = run_budget;
+  if (tuner_window > 0)
+  {
+    tuner.clamp(impl);
+    if (tuner_bounds[TUNE_EPOCH][0] < tuner_bounds[TUNE_EPOCH][1]) budget = 0;
+  }
 
   while (!done)
   {
-    // worker fitness
+    // only first thread talks to master
+    if (index == 0 && sync_master(impl) == false)
+    {
+      done = true;
+      break;
+    }
+
+    // evolve the graph until next sync or termination
+    auto start = std::chrono::steady_clock::now();
+    impl.run(budget, &done);
+    if (done) break;
+    runs++;
+
+    // adjust throughput parameters
+    if (tuner_window > 0)
+    {
+      auto end = std::chrono::steady_clock::now();
+      tuner.update(impl, std::chrono::duration<double>(end - start).count());
+    }
+
+    // update process champion
     auto fitness = impl.fitness();
-    
-    // master fitness
-    auto master_fitness = get_fitness();
-    
-    // stop if desiret accuracy was reached
-    if (master_fitness >= impl.objective()) break;
-    
-    // validate fitness
-    bool master_nan = std::isnan(master_fitness);
-    bool worker_nan = std::isnan(fitness);
-    
-    // get master graph to local population
-    if (master_fitness > fitness || (!master_nan && worker_nan))
     {
-      impl.seed(get_graph(fitness));
+      std::lock_guard<std::mutex> lock(champion_lock);
+      if (!std::isnan(fitness) &&
+          (std::isnan(champion.fitness) || fitness > champion.fitness))
+      {
+        champion.fitness = fitness;
+        champion.graph = impl.best();
+      }
     }
-    else
-    // send localy fit graph to master
-    if (master_fitness < fitness || (master_nan && !worker_nan))
+
+    // exchange graphs with other islands
+    if (migration_period > 0 && runs % migration_period == 0)
     {
-      set_graph(impl.best(), fitness, master_fitness);
+      migrate(index, impl, rng);
+      immigrate(index, impl);
     }
 
-    // evolve the graph
-    impl.run();
+    // check champion accuracy on test data
+    if (index == 0 && validate_period > 0 && runs % validate_period == 0)
+    {
+      std::string graph;
+      {
+        std::lock_guard<std::mutex> lock(champion_lock);
+        graph = champion.graph;
+      }
+      // other islands keep their cores, pool of run is reused
+      log_validation(impl.validate(graph, impl.threads()));
+    }
   }
 
   destroy(&impl);
 }
 
-void worker_run(const std::string& impl, const std::string& host, int port)
-{  
+void* worker_load(const std::string& impl)
+{
   void* handle = dlopen(impl.c_str(), RTLD_LAZY);
   if (handle == nullptr)
   {
@@ -154,6 +346,13 @@ void worker_run(const std::string& impl, const std::string& host, int port)
   if (destroy == nullptr)
     throw std::runtime_error("Failed to locate symbol 'destroy'");
 
+  return handle;
+}
+
+void worker_run(const std::string& impl, const std::string& host, int port)
+{  
+  void* handle = worker_load(impl);
+
   ::host = host;
   ::port = port;
 
@@ -162,13 +361,73 @@ void worker_run(const std::string& impl, const std::string& host, int port)
   int threads = std::thread::hardware_concurrency();
   std::cout << "starting " << threads << " threads..." << std::endl;
 
-  for (int i=0; i<threads; i++) pool.emplace_back(thread_run);
+  for (int i=0; i<threads; i++) islands.push_back(new BoundedQueue<Migrant>(MIGRATION_QUEUE));
+  for (int i=0; i<threads; i++) pool.emplace_back(thread_run, i);
 
   for (auto& e: pool) e.join();
+  for (auto e: islands) delete e;
+  islands.clear();
   
   dlclose(handle);
 }
 
+void worker_train(const std::string& impl, const std::string& file, int epochs)
+{
+  void* handle = worker_load(impl);
+  NeuroEvolution& evolution = *create();
+
+  std::string graph;
+  float fitness = NAN;
+  load_graph(graph, fitness, file);
+
+  Graph* g = evolution.create(graph);
+  if (g == nullptr)
+  {
+    destroy(&evolution);
+    dlclose(handle);
+    throw std::runtime_error("Failed to load graph from '" + file + "'");
+  }
+
+  int threads = std::thread::hardware_concurrency();
+  std::cout << "training on " << threads << " threads..." << std::endl;
+
+  // train single graph on all threads
+  for (int i=0; i<epochs && !done; i++)
+  {
+    fitness = evolution.tune(*g, threads);
+    std::cout << "epoch " << i << ", fitness " << fitness << std::endl;
+  }
+
+  save_graph(g->save(), fitness, file);
+  std::cout << "graph saved in " << file << std::endl;
+
+  delete g;
+  destroy(&evolution);
+  dlclose(handle);
+}
+
+void worker_validate(const std::string& impl, const std::string& file)
+{
+  void* handle = worker_load(impl);
+  NeuroEvolution& evolution = *create();
+
+  std::string graph;
+  float fitness = NAN;
+  load_graph(graph, fitness, file);
+
+  int threads = std::thread::hardware_concurrency();
+  std::cout << "validating on " << threads << " threads..." << std::endl;
+
+  auto v = evolution.validate(graph, threads);
+  std::cout << "fitness " << fitness
+            << ", test accuracy " << v.accuracy
+            << ", samples " << v.samples
+            << ", time " << v.seconds << "s" << std::endl;
+
+  destroy(&evolution);
+  dlclose(handle);
+}
+
 void worker_term()
 {
   done = true;